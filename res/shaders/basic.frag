@@ -10,6 +10,8 @@ uniform float u_Trigger1;
 uniform float u_Trigger2;
 uniform float u_TimeWarp1;
 uniform float u_TimeWarp2;
+uniform float u_Rms1;
+uniform float u_Rms2;
 
 float getWaveform1(vec2 uv, float timeOffset) {
     float audioIndex = uv.x * 255.0;
@@ -58,22 +60,6 @@ vec3 colorGradient(float t) {
     }
 }
 
-float getEnergy1() {
-    float energy = 0.0;
-    for (int i = 0; i < 256; i += 4) {
-        energy += abs(u_AudioData1[i]);
-    }
-    return energy / 64.0;
-}
-
-float getEnergy2() {
-    float energy = 0.0;
-    for (int i = 0; i < 256; i += 4) {
-        energy += abs(u_AudioData2[i]);
-    }
-    return energy / 64.0;
-}
-
 void main() {
     vec2 uv = fs_TexCoord;
     
@@ -89,8 +75,8 @@ void main() {
     float waveform1_warped = getWaveform1(vec2(uv.x + flowOffset1, uv.y + flowOffset2), warpedTime1);
     float waveform2_warped = getWaveform2(vec2(uv.x - flowOffset2, uv.y - flowOffset1), warpedTime2);
     
-    float energy1 = getEnergy1();
-    float energy2 = getEnergy2();
+    float energy1 = u_Rms1;
+    float energy2 = u_Rms2;
     
     vec3 color1 = colorGradient(uv.x + warpedTime1 * 0.1);
     vec3 color2 = colorGradient(uv.x + warpedTime2 * 0.15 + 0.3);
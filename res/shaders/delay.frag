@@ -0,0 +1,52 @@
+#version 120
+
+// GLAZE demo: a feedback delay whose memory lives entirely on the GPU.
+// pass 0 updates u_History, pass 1 updates u_Filter, the last pass writes L/R.
+#pragma glaze state u_History 256
+#pragma glaze state u_Filter 1
+
+uniform float audioInL;
+uniform float audioInR;
+uniform float u1;
+uniform float u2;
+uniform float u3;
+uniform int mode;
+uniform int u_Pass;
+uniform int u_Frame;
+uniform sampler2D u_History;
+uniform sampler2D u_Filter;
+
+const float HISTORY = 256.0;
+
+float writeHead() {
+    return mod(float(u_Frame), HISTORY);
+}
+
+vec4 readHistory(float age) {
+    float index = mod(writeHead() - age + HISTORY, HISTORY);
+    return texture2D(u_History, vec2((index + 0.5) / HISTORY, 0.5));
+}
+
+void main() {
+    vec4 filtered = texture2D(u_Filter, vec2(0.5));
+
+    if (u_Pass == 0) {
+        // history: write input + feedback at the write head, keep every other texel
+        vec4 previous = texture2D(u_History, vec2(gl_FragCoord.x / HISTORY, 0.5));
+        if (floor(gl_FragCoord.x) == writeHead()) {
+            float feedback = u2 * 0.95;
+            gl_FragColor = vec4(audioInL + filtered.x * feedback, audioInR + filtered.y * feedback, 0.0, 1.0);
+        } else {
+            gl_FragColor = previous;
+        }
+    } else if (u_Pass == 1) {
+        // filter: one-pole damping of the delayed signal
+        float age = 1.0 + floor(u1 * (HISTORY - 2.0));
+        vec4 delayed = readHistory(age);
+        float damping = u3 * 0.9;
+        gl_FragColor = mix(delayed, filtered, damping);
+    } else {
+        float channel = gl_FragCoord.x < 1.0 ? filtered.x : filtered.y;
+        gl_FragColor = vec4(channel, 0.0, 0.0, 1.0);
+    }
+}
@@ -0,0 +1,26 @@
+#version 120
+
+uniform float u_Time;
+uniform float u_Chaos;
+uniform float u_Scale;
+uniform float u_ClockTime;
+uniform float u_TimeSpace;
+uniform float u_Channels;
+
+// one row per voice: gl_FragCoord.y is the voice index, so every voice
+// gets the same four lfos spread out in phase and rate
+void main() {
+    float voice = floor(gl_FragCoord.y);
+    float spread = voice / max(u_Channels, 1.0);
+    float t = u_Time + u_ClockTime;
+    float rate = 1.0 + u_Chaos * spread * 3.0;
+
+    vec4 cv;
+    cv.x = sin(t * rate + spread * 6.28318);
+    cv.y = cos(t * 0.5 * rate + spread * 3.14159);
+    cv.z = fract(t * 0.25 * rate + spread) * 2.0 - 1.0;
+    cv.w = mix(sin(t * 2.0 + spread * 6.28318), sign(sin(t * 2.0 + spread * 6.28318)), u_TimeSpace);
+
+    cv = clamp(cv * u_Scale, -1.0, 1.0);
+    gl_FragColor = cv * 0.5 + 0.5;
+}
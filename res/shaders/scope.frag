@@ -0,0 +1,11 @@
+#version 120
+
+// Canvas demo for geometry mode, see scope.vert. older samples fade out
+
+varying float fs_Instance;
+varying float fs_Age;
+
+void main() {
+    vec3 color = fs_Instance < 0.5 ? vec3(0.3, 1.0, 0.6) : vec3(1.0, 0.5, 0.2);
+    gl_FragColor = vec4(color, mix(0.2, 1.0, fs_Age));
+}
@@ -0,0 +1,42 @@
+#version 120
+
+// Canvas demo for geometry mode. instance 0 draws input 1 as a waveform,
+// instance 1 plots input 1 against input 2 (XY / Lissajous). every vertex
+// reads one history entry, so only the pixels on the line are shaded
+#pragma canvas geometry line_strip 2048 2
+
+attribute float vs_Index;
+attribute float vs_Instance;
+
+varying float fs_Instance;
+varying float fs_Age;
+
+uniform sampler2D u_AudioHistory1;
+uniform sampler2D u_AudioHistory2;
+uniform float u_AudioHead1;
+uniform float u_AudioHead2;
+uniform float u_AudioSize;
+uniform float u_AudioLength;
+uniform vec2 u_Resolution;
+
+float readAudio(sampler2D history, float head, float k) {
+    float texel = mod(head - k, u_AudioSize);
+    return texture2DLod(history, vec2((texel + 0.5) / u_AudioSize, 0.5 / 16.0), 0.0).r;
+}
+
+void main() {
+    // the 2048 vertices span the displayed history, oldest first
+    float t = vs_Index / 2047.0;
+    float k = floor((1.0 - t) * (u_AudioLength - 1.0));
+    float a = readAudio(u_AudioHistory1, u_AudioHead1, k);
+    vec2 position;
+    if (vs_Instance < 0.5) {
+        position = vec2(t * 2.0 - 1.0, a * 0.9);
+    } else {
+        float b = readAudio(u_AudioHistory2, u_AudioHead2, k);
+        position = vec2(a * u_Resolution.y / u_Resolution.x, b) * 0.9;
+    }
+    gl_Position = vec4(position, 0.0, 1.0);
+    fs_Instance = vs_Instance;
+    fs_Age = t;
+}
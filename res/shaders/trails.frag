@@ -0,0 +1,55 @@
+#version 120
+
+// Canvas demo: fading oscilloscope trails computed incrementally.
+// pass 0 draws the newest waveforms into u_Trail at half resolution on top of
+// its own previous frame, the visible pass colors it and mixes in u_PrevFrame.
+#pragma canvas pass u_Trail 0.5
+
+varying vec2 fs_TexCoord;
+
+uniform sampler2D u_AudioHistory1;
+uniform sampler2D u_AudioHistory2;
+uniform float u_AudioHead1;
+uniform float u_AudioHead2;
+uniform float u_AudioSize;
+uniform float u_AudioLength;
+uniform float u_Rms1;
+uniform float u_Rms2;
+uniform float u_TimeWarp1;
+uniform float u_TimeWarp2;
+uniform int u_Pass;
+uniform int u_PassCount;
+uniform vec2 u_PassSize;
+uniform sampler2D u_Trail;
+uniform sampler2D u_PrevFrame;
+
+float readAudio(sampler2D history, float head, float x) {
+    float texel = mod(head - floor((1.0 - x) * u_AudioLength), u_AudioSize);
+    return texture2D(history, vec2((texel + 0.5) / u_AudioSize, 0.5 / 16.0)).r;
+}
+
+float line(float value, float y) {
+    return smoothstep(0.02, 0.0, abs(y - 0.5 - value * 0.4));
+}
+
+void main() {
+    vec2 uv = gl_FragCoord.xy / u_PassSize;
+
+    if (u_Pass == 0) {
+        // decay: the knobs set how long the trails of each input last
+        vec3 previous = texture2D(u_Trail, uv).rgb;
+        vec2 decay = 0.9 + 0.009 * (vec2(u_TimeWarp1, u_TimeWarp2) + 10.0) * 0.5;
+        float wave1 = line(readAudio(u_AudioHistory1, u_AudioHead1, uv.x), uv.y);
+        float wave2 = line(readAudio(u_AudioHistory2, u_AudioHead2, uv.x), uv.y);
+        vec2 trail = max(previous.rg * decay, vec2(wave1, wave2));
+        gl_FragColor = vec4(trail, 0.0, 1.0);
+        return;
+    }
+
+    vec2 trail = texture2D(u_Trail, uv).rg;
+    vec3 color = trail.x * vec3(0.2, 0.9, 0.9) * (1.0 + u_Rms1)
+               + trail.y * vec3(1.0, 0.3, 0.5) * (1.0 + u_Rms2);
+    // a slight zoom of the previous frame lets the glow drift outwards
+    vec3 echo = texture2D(u_PrevFrame, (uv - 0.5) * 0.99 + 0.5).rgb;
+    gl_FragColor = vec4(max(color, echo * 0.85), 1.0);
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include "plugin.hpp"
+#include <cmath>
+
+// running descriptors of one audio signal (RMS, peak, onset, centroid and four
+// band levels), updated sample by sample on the audio thread so shaders read a
+// scalar instead of summing an audio history for every pixel. process() is a
+// handful of one-pole filters; the square roots happen in the getters, which
+// the GPU/UI threads call once per frame
+struct AudioFeatures {
+    static const int BANDS = 4;
+
+    float sampleRate = 44100.f;
+    // one-pole coefficients, see setSampleRate()
+    float meanCoef = 0.f;
+    float fastCoef = 0.f;
+    float peakRelease = 0.f;
+    float onsetRelease = 0.f;
+    float crossoverCoefs[BANDS - 1] = {};
+
+    // mean squares of the signal, its first difference and each band
+    float meanSquare = 0.f;
+    float fastSquare = 0.f;
+    float diffSquare = 0.f;
+    float bandSquares[BANDS] = {};
+    float crossovers[BANDS - 1] = {};
+    float lastSample = 0.f;
+    float peak = 0.f;
+    float onset = 0.f;
+
+    AudioFeatures() {
+        setSampleRate(sampleRate);
+    }
+
+    void setSampleRate(float rate) {
+        sampleRate = rate;
+        // ~50 ms averaging, ~5 ms for onsets, ~300 ms peak and onset release
+        meanCoef = 1.f - std::exp(-1.f / (0.05f * rate));
+        fastCoef = 1.f - std::exp(-1.f / (0.005f * rate));
+        peakRelease = std::exp(-1.f / (0.3f * rate));
+        onsetRelease = peakRelease;
+        // band edges: low < 200 Hz < low mid < 1 kHz < high mid < 5 kHz < high
+        static const float edges[BANDS - 1] = {200.f, 1000.f, 5000.f};
+        for (int i = 0; i < BANDS - 1; i++) {
+            crossoverCoefs[i] = 1.f - std::exp(-2.f * M_PI * std::min(edges[i], 0.45f * rate) / rate);
+        }
+    }
+
+    void process(float x) {
+        float square = x * x;
+        meanSquare += (square - meanSquare) * meanCoef;
+        fastSquare += (square - fastSquare) * fastCoef;
+        float diff = x - lastSample;
+        lastSample = x;
+        diffSquare += (diff * diff - diffSquare) * meanCoef;
+
+        float level = std::fabs(x);
+        peak = level > peak ? level : peak * peakRelease;
+        // energy rising well above the 50 ms average. the margin keeps the
+        // ripple of steady low tones from reading as onsets
+        float flux = fastSquare - 1.5f * meanSquare;
+        onset = flux > onset ? flux : onset * onsetRelease;
+
+        float below = 0.f;
+        for (int i = 0; i < BANDS - 1; i++) {
+            crossovers[i] += (x - crossovers[i]) * crossoverCoefs[i];
+            float band = crossovers[i] - below;
+            bandSquares[i] += (band * band - bandSquares[i]) * meanCoef;
+            below = crossovers[i];
+        }
+        float high = x - below;
+        bandSquares[BANDS - 1] += (high * high - bandSquares[BANDS - 1]) * meanCoef;
+    }
+
+    float getRms() const {
+        return std::sqrt(meanSquare);
+    }
+
+    float getOnset() const {
+        return std::sqrt(std::max(onset, 0.f));
+    }
+
+    // estimated from how fast the signal changes relative to its level: a sine
+    // at f has rms(diff) / rms = 2 sin(pi f / sampleRate). in Hz, 0 for silence
+    float getCentroid() const {
+        if (meanSquare < 1e-10f) return 0.f;
+        float ratio = std::sqrt(diffSquare / meanSquare) * 0.5f;
+        return sampleRate / M_PI * std::asin(std::min(ratio, 1.f));
+    }
+
+    float getBand(int band) const {
+        return std::sqrt(bandSquares[band]);
+    }
+};
+
+// `u_Rms<n>`, `u_Peak<n>`, `u_Onset<n>`, `u_Centroid<n>` and `vec4 u_Bands<n>`
+// for input n of a module, in whichever of its programs declares them
+struct AudioFeatureUniforms {
+    GLint rms = -1;
+    GLint peak = -1;
+    GLint onset = -1;
+    GLint centroid = -1;
+    GLint bands = -1;
+
+    void locate(GLuint program, int input) {
+        rms = glGetUniformLocation(program, string::f("u_Rms%d", input).c_str());
+        peak = glGetUniformLocation(program, string::f("u_Peak%d", input).c_str());
+        onset = glGetUniformLocation(program, string::f("u_Onset%d", input).c_str());
+        centroid = glGetUniformLocation(program, string::f("u_Centroid%d", input).c_str());
+        bands = glGetUniformLocation(program, string::f("u_Bands%d", input).c_str());
+    }
+
+    // the program must be in use
+    void set(const AudioFeatures& features) const {
+        if (rms >= 0) glUniform1f(rms, features.getRms());
+        if (peak >= 0) glUniform1f(peak, features.peak);
+        if (onset >= 0) glUniform1f(onset, features.getOnset());
+        if (centroid >= 0) glUniform1f(centroid, features.getCentroid());
+        if (bands >= 0) {
+            glUniform4f(bands, features.getBand(0), features.getBand(1), features.getBand(2), features.getBand(3));
+        }
+    }
+};
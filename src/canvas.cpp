@@ -6,6 +6,13 @@
 #include <sstream>
 #include "shader_menu.hpp"
 #include "gl_utils.hpp"
+#include "shader_rewrite.hpp"
+#include "worker.hpp"
+#include "audio_features.hpp"
+#include "frame_recorder.hpp"
+#include "texture_cache.hpp"
+#include <osdialog.h>
+#include <atomic>
 
 void checkGLError(const char* location) {
 	GLenum err;
@@ -44,12 +51,58 @@ GLuint compileShader(const std::string& source, GLenum type) {
 
 struct Canvas;
 
+// magnitude spectra of both inputs, built on the Worker. each input gets two
+// rows of `bins` values: row 0 is linear (texel k is bin k), row 1 the same
+// spectrum resampled onto a log-frequency axis from 20 Hz to Nyquist. values
+// are 0-1 for -90-0 dB, where 0 dB is a full-scale (5V) sine
+struct Spectrum {
+	static const int MIN_SIZE = 1024;
+	static const int MAX_SIZE = 8192;
+	int bins = 0;
+	std::vector<float> rows[2];
+	// no value moved from the previous spectrum, e.g. once peak hold has decayed
+	bool settled = false;
+};
+
+enum SpectrumResponse {
+	SPECTRUM_RAW,
+	SPECTRUM_SMOOTH,
+	SPECTRUM_PEAK_HOLD,
+	SPECTRUM_RESPONSES_LEN
+};
+
+struct SpectrumSlot : Handoff<Spectrum> {
+	std::atomic<bool> building{false};
+	// the previous result, for smoothing and peak hold. worker only
+	std::vector<float> previous[2];
+};
+
+// min/max/RMS summaries of channel 0 of each input's history ring, for long
+// overviews. level L has HISTORY_SIZE >> L texels and texel i covers ring
+// entries [i << L, (i + 1) << L) as (min, max, mean square); level 0 is the
+// raw ring. the Worker keeps the whole pyramid and only hands over the texels
+// that changed, each new entry touching one texel per level
+struct PyramidUpdate {
+	static const int LEVELS = 15;
+	// per level, texels [start, start + count) changed, wrapping around
+	int start[LEVELS] = {};
+	int count[LEVELS] = {};
+	std::vector<float> texels[2][LEVELS];
+};
+
+struct PyramidSlot : Handoff<PyramidUpdate> {
+	std::atomic<bool> building{false};
+	// worker only
+	std::vector<float> levels[2][PyramidUpdate::LEVELS];
+};
+
 struct GLCanvasWidget : rack::widget::OpenGlWidget {
 	GLuint shaderProgram = 0;
+	// compiling in the CompileQueue; shaderProgram keeps drawing until it is linked
+	GLuint pendingProgram = 0;
+	ShaderPair pendingShader;
 	GLuint VBO = 0;
 	GLuint EBO = 0;
-	GLuint frameBuffer = 0;
-	GLuint renderTexture = 0;
 	float startTime = 0.f;
 	bool dirty = true;
 	bool initialized = false;
@@ -58,14 +111,148 @@ struct GLCanvasWidget : rack::widget::OpenGlWidget {
 	GLint texCoordAttrib = -1;
 	GLint timeUniform = -1;
 	GLint resolutionUniform = -1;
-	GLint audioData1Uniform = -1;
-	GLint audioData2Uniform = -1;
 	GLint projUniform = -1;
 	GLint modelUniform = -1;
 	GLint trigger1Uniform = -1;
 	GLint trigger2Uniform = -1;
 	GLint timeWarp1Uniform = -1;
 	GLint timeWarp2Uniform = -1;
+	GLint audioHistory1Uniform = -1;
+	GLint audioHistory2Uniform = -1;
+	GLint audioHeadUniform = -1;
+	GLint audioHead1Uniform = -1;
+	GLint audioHead2Uniform = -1;
+	GLint audioSizeUniform = -1;
+	GLint audioLengthUniform = -1;
+	GLint channelsUniform = -1;
+	GLint spectrum1Uniform = -1;
+	GLint spectrum2Uniform = -1;
+	GLint spectrumSizeUniform = -1;
+	GLint pyramid1Uniform = -1;
+	GLint pyramid2Uniform = -1;
+	AudioFeatureUniforms featureUniforms[2];
+
+	// geometry mode, `#pragma canvas geometry <primitive> <count> [instances]`
+	// in the vertex shader: every draw emits `count` vertices of the primitive,
+	// `instances` times, instead of the fullscreen quad. there are no positions;
+	// the vertex shader gets `attribute float vs_Index` (0 to count - 1) and
+	// `attribute float vs_Instance` and pulls its samples from the history
+	// textures, so fragment cost follows the pixels covered, not the canvas area
+	GLenum geometryPrimitive = 0;
+	int geometryCount = 0;
+	int geometryInstances = 1;
+	// every entry of both history textures, 16 channels of HISTORY_SIZE
+	static const int MAX_GEOMETRY_VERTICES = 16 * 16384;
+	GLuint indexBuffer = 0;
+	int indexBufferSize = 0;
+	GLint indexAttrib = -1;
+	GLint instanceAttrib = -1;
+
+	// ping-pong targets declared with `#pragma canvas pass <sampler name> [scale]`.
+	// every frame renders them in declaration order (u_Pass = index) at scale
+	// times the canvas size, then the visible pass (u_Pass = u_PassCount). each
+	// pass sees every pass's newest texture; its own is the previous frame's.
+	// framePass backs u_PrevFrame: when declared, the visible pass is rendered
+	// there first and blitted to the widget
+	struct Pass {
+		std::string name;
+		float scale = 1.f;
+		int width = 0;
+		int height = 0;
+		GLuint textures[2] = {0, 0};
+		GLuint frameBuffers[2] = {0, 0};
+		int readIndex = 0;
+		GLint samplerUniform = -1;
+	};
+	static const int MAX_PASSES = 8;
+	// units 0-3 hold the history and spectrum textures
+	static const int PASS_TEXTURE_UNIT = 4;
+	std::vector<Pass> passes;
+	Pass framePass;
+	GLint passUniform = -1;
+	GLint passCountUniform = -1;
+	GLint passSizeUniform = -1;
+	GLint frameUniform = -1;
+	int frameCount = 0;
+
+	// recording: drawn frames are read back asynchronously, so neither the
+	// readback nor the recorder's disk writes ever stall the UI thread
+	gl::ReadbackRing recordReadback;
+	std::shared_ptr<FrameRecorder> recorder;
+
+	// pixel probes declared with `#pragma canvas probe <x> <y> [width height]`,
+	// in 0-1 canvas coordinates from the bottom left. each probe is one channel
+	// of the probe outputs, averaged over its region (one pixel by default).
+	// only the bounding box of all probes is read back, and only while a probe
+	// output is connected
+	struct Probe {
+		float x = 0.f;
+		float y = 0.f;
+		float width = 0.f;
+		float height = 0.f;
+	};
+	static const int MAX_PROBES = PORT_MAX_CHANNELS;
+	std::vector<Probe> probes;
+	gl::ReadbackRing probeReadback;
+
+	// render scale and frame pacing. the framebuffer is rendered at `oversample`
+	// times its size and stretched back up (bilinearly) when drawn. autoScale is
+	// the scale picked by the automatic mode from the GL_TIME_ELAPSED of past frames
+	float autoScale = 1.f;
+	GLuint timerQuery = 0;
+	bool timerPending = false;
+	double lastRenderTime = 0.0;
+	// when either input last rose above silence
+	double lastSoundTime = 0.0;
+	// the previous frame was drawn from inputs that can't change the picture
+	bool renderedStill = false;
+	float renderedTimeWarp[2] = {0.f, 0.f};
+	float renderedTrigger[2] = {0.f, 0.f};
+
+	// draw() only runs while the canvas is on-screen. once it hasn't for
+	// HIDDEN_SECONDS the canvas stops rendering, unless probes or a recording
+	// still want frames, and after RELEASE_SECONDS it frees its GPU resources.
+	// the next step() on-screen builds them again from the shader
+	static constexpr float HIDDEN_SECONDS = 0.5f;
+	static constexpr float RELEASE_SECONDS = 10.f;
+	double lastDrawTime = 0.0;
+	bool released = false;
+
+	// ring textures mirroring Canvas::history. uploadedHead is the module's
+	// historyHead at the last upload, so each frame only sends what's new.
+	// smoothing runs here on the way up rather than on the audio thread
+	GLuint historyTextures[2] = {0, 0};
+	uint32_t uploadedHead = 0;
+	// uploadRows[n] is the most channels input n has had since the textures
+	// were created; rows past it are still zero and are skipped
+	std::vector<float> uploadBuffer;
+	float smoothed[2][PORT_MAX_CHANNELS] = {};
+	int uploadRows[2] = {1, 1};
+
+	// u_Spectrum1/2 are only computed while the shader uses them. spectrumHead
+	// is the historyHead the last request was made at
+	GLuint spectrumTextures[2] = {0, 0};
+	int spectrumTextureBins = 0;
+	Spectrum* spectrum = nullptr;
+	std::shared_ptr<SpectrumSlot> spectrumSlot = std::make_shared<SpectrumSlot>();
+	uint32_t spectrumHead = 0;
+
+	// u_AudioPyramid1/2, one row per level, are likewise only kept up to date
+	// while the shader uses them. pyramidHead is the historyHead the last
+	// request went up to
+	static const int PYRAMID_TEXTURE_UNIT = PASS_TEXTURE_UNIT + MAX_PASSES + 1;
+	GLuint pyramidTextures[2] = {0, 0};
+	PyramidUpdate* pyramidUpdate = nullptr;
+	std::shared_ptr<PyramidSlot> pyramidSlot = std::make_shared<PyramidSlot>();
+	uint32_t pyramidHead = 0;
+
+	// images declared with `#pragma canvas texture <0-3> <path>` and bound to
+	// u_Texture0-3. relative paths start at the shader's directory. they come
+	// from the plugin-wide TextureCache and read as black while still loading
+	static const int MAX_TEXTURES = 4;
+	static const int IMAGE_TEXTURE_UNIT = PYRAMID_TEXTURE_UNIT + 2;
+	TextureCache::Handle textures[MAX_TEXTURES];
+	GLint textureUniforms[MAX_TEXTURES] = {-1, -1, -1, -1};
 	
 	Canvas* module = nullptr;
 	
@@ -76,8 +263,6 @@ struct GLCanvasWidget : rack::widget::OpenGlWidget {
 		shaderProgram = 0;
 		VBO = 0;
 		EBO = 0;
-		frameBuffer = 0;
-		renderTexture = 0;
 		dirty = true;
 		initialized = false;
 		
@@ -85,52 +270,67 @@ struct GLCanvasWidget : rack::widget::OpenGlWidget {
 		texCoordAttrib = -1;
 		timeUniform = -1;
 		resolutionUniform = -1;
-		audioData1Uniform = -1;
-		audioData2Uniform = -1;
 		projUniform = -1;
 		modelUniform = -1;
 		trigger1Uniform = -1;
 		trigger2Uniform = -1;
 		timeWarp1Uniform = -1;
 		timeWarp2Uniform = -1;
+		audioHistory1Uniform = -1;
+		audioHistory2Uniform = -1;
+		audioHeadUniform = -1;
+		audioHead1Uniform = -1;
+		audioHead2Uniform = -1;
+		audioSizeUniform = -1;
+		audioLengthUniform = -1;
+		channelsUniform = -1;
+		spectrum1Uniform = -1;
+		spectrum2Uniform = -1;
+		spectrumSizeUniform = -1;
+		pyramid1Uniform = -1;
+		pyramid2Uniform = -1;
 		
 		module = nullptr;
 
 		visible = true;
 	}
 	
-	void setupFramebuffer() {
-		if (frameBuffer) {
-			glDeleteFramebuffers(1, &frameBuffer);
-			frameBuffer = 0;
-		}
-		if (renderTexture) {
-			glDeleteTextures(1, &renderTexture);
-			renderTexture = 0;
-		}
-		
-		glGenFramebuffers(1, &frameBuffer);
-		glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
-		
-		glGenTextures(1, &renderTexture);
-		glBindTexture(GL_TEXTURE_2D, renderTexture);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, 1, 1, 0, GL_RGBA, GL_FLOAT, NULL);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, renderTexture, 0);
-		
-		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-			WARN("Framebuffer is not complete!");
-			throw std::runtime_error("Failed to create framebuffer");
-		}
-		
-		gl::checkError("setupFramebuffer");
-	}
-	
 	void setModule(Canvas* mod);
 	void createShaderProgram();
+	void installShaderProgram();
 	void setupGeometry();
+	void setupGeometryMode(const std::string& vertexSource);
+	void drawGeometry();
+	void setupPasses(const std::string& fragmentSource);
+	void setupProbes(const std::string& fragmentSource);
+	void setupTextures(const ShaderPair& shaderPair);
+	bool isLoadingTextures() const;
+	void getProbeRect(const Probe& probe, int width, int height, int* rect) const;
+	void readProbes(int width, int height);
+	void collectProbes();
+	void resizePass(Pass& pass, int width, int height);
+	void deletePass(Pass& pass);
+	void bindPassTextures();
+	void drawPasses(int width, int height);
+	void startRecording(const std::string& path);
+	void stopRecording();
+	void captureFrame(int width, int height);
+	void collectFrames();
+	void setupHistoryTextures();
+	void uploadHistory();
+	uint32_t getDisplayHead(int input) const;
+	bool shouldRender();
+	void readGpuTime();
+	void requestSpectrum();
+	void uploadSpectrum();
+	void requestPyramid();
+	void uploadPyramid();
+	static std::string buildAudioShaderSource(const std::string& fragmentSource);
+	bool isHidden() const;
+	void releaseResources();
+	size_t getGpuMemory();
 	void step() override;
+	void draw(const DrawArgs& args) override;
 	void drawFramebuffer() override;
 	~GLCanvasWidget();
 };
@@ -151,6 +351,10 @@ struct Canvas : Module, ShaderSubscriber {
 	enum OutputId {
 		OUTPUT_1,
 		OUTPUT_2,
+		OUTPUT_PROBE_R,
+		OUTPUT_PROBE_G,
+		OUTPUT_PROBE_B,
+		OUTPUT_PROBE_A,
 		OUTPUTS_LEN
 	};
 	enum LightId {
@@ -159,9 +363,46 @@ struct Canvas : Module, ShaderSubscriber {
 
 	int ch1 = 0;
 	int ch2 = 0;
-	float audioBuffer1[256] = {0.f};
-	float audioBuffer2[256] = {0.f};
+	// input history, one entry per `decimation` engine samples (their mean)
+	// and one row per poly channel, zero past the input's channel count.
+	// historyHead counts every entry ever written, so
+	// history[n][channel][historyHead % HISTORY_SIZE] is the next slot
+	static const int HISTORY_SIZE = 16384;
+	float history[2][PORT_MAX_CHANNELS][HISTORY_SIZE] = {};
+	std::atomic<uint32_t> historyHead{0};
+	int decimation = 1;
+	int decimationCount = 0;
+	float decimationSum[2][PORT_MAX_CHANNELS] = {};
+	// entries shown by the shaders; also what the legacy 256-entry u_AudioData arrays span
+	int historyLength = 256;
+	// applied by the widget while uploading, 0 = raw
 	float smoothingFactor = 0.3f;
+	// u_Rms1, u_Peak1, ... see audio_features.hpp
+	AudioFeatures features[2];
+	// 0 = automatic, see GLCanvasWidget::readGpuTime()
+	float renderScale = 1.f;
+	// 0 = every UI frame
+	int maxFps = 0;
+	int recordFormat = FrameRecorder::FORMAT_Y4M;
+	// FFT size and response of u_Spectrum1/2
+	int spectrumSize = 2048;
+	int spectrumResponse = SPECTRUM_SMOOTH;
+	// probe colours, 0-1 per channel and component. the widget writes the
+	// targets from its readbacks, which arrive at the UI frame rate; process()
+	// glides toward them over probeSmoothing seconds
+	std::atomic<int> probeCount{0};
+	float probeTargets[4][PORT_MAX_CHANNELS] = {};
+	float probeValues[4][PORT_MAX_CHANNELS] = {};
+	float probeSmoothing = 0.02f;
+
+	// with trigger sync, a rising edge on INPUT_TRIG_n starts a capture of
+	// historyLength entries. once it is complete, capturedHead[n] is the
+	// historyHead value just past its end and the widget displays that window
+	bool triggerSync = false;
+	dsp::SchmittTrigger captureTriggers[2];
+	bool capturing[2] = {false, false};
+	uint32_t triggerHead[2] = {0, 0};
+	std::atomic<uint32_t> capturedHead[2];
 	float timeWarp1 = 0.0f;
 	float timeWarp2 = 0.0f;
 	float trig1 = 0.0f;
@@ -181,6 +422,10 @@ struct Canvas : Module, ShaderSubscriber {
 		configParam(PARAM_TIME_2, -10.0, 10.0, 0.0, "time warp 2 factor", "");
 		configOutput(OUTPUT_1, "audio output 1");
 		configOutput(OUTPUT_2, "audio output 2");
+		configOutput(OUTPUT_PROBE_R, "probe red");
+		configOutput(OUTPUT_PROBE_G, "probe green");
+		configOutput(OUTPUT_PROBE_B, "probe blue");
+		configOutput(OUTPUT_PROBE_A, "probe alpha");
 
 		ch1 = 0;
 		ch2 = 0;
@@ -192,9 +437,8 @@ struct Canvas : Module, ShaderSubscriber {
 		subscribedGlibId = -1;
 		subscribedShaderIndex = -1;
 		glCanvas = nullptr;
-
-		std::fill(audioBuffer1, audioBuffer1 + 256, 0.f);
-		std::fill(audioBuffer2, audioBuffer2 + 256, 0.f);
+		capturedHead[0] = 0;
+		capturedHead[1] = 0;
 	}
 
 	void process(const ProcessArgs& args) override {
@@ -231,13 +475,136 @@ struct Canvas : Module, ShaderSubscriber {
 			outputs[OUTPUT_2].writeVoltages(inputs[INPUT_2].getVoltages());
 		}
 
-		// shift buffer and apply smoothing
-		for (int i = 255; i > 0; i--) {
-			audioBuffer1[i] = audioBuffer1[i-1] * (1.f - smoothingFactor) + audioBuffer1[i] * smoothingFactor;
-			audioBuffer2[i] = audioBuffer2[i-1] * (1.f - smoothingFactor) + audioBuffer2[i] * smoothingFactor;
+		features[0].process(in1);
+		features[1].process(in2);
+		processProbes(args);
+
+		if (triggerSync) {
+			for (int n = 0; n < 2; n++) {
+				float trigger = inputs[n == 0 ? INPUT_TRIG_1 : INPUT_TRIG_2].getVoltage();
+				if (captureTriggers[n].process(trigger, 0.1f, 1.f) && !capturing[n]) {
+					capturing[n] = true;
+					triggerHead[n] = historyHead.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		const int channels[2] = {channels1, channels2};
+		for (int n = 0; n < 2; n++) {
+			const float* voltages = inputs[n == 0 ? INPUT_1 : INPUT_2].getVoltages();
+			for (int c = 0; c < channels[n]; c++) {
+				decimationSum[n][c] += voltages[c] / 5.f;
+			}
+		}
+		if (++decimationCount < decimation) return;
+
+		uint32_t head = historyHead.load(std::memory_order_relaxed);
+		float scale = 1.f / decimationCount;
+		for (int n = 0; n < 2; n++) {
+			for (int c = 0; c < PORT_MAX_CHANNELS; c++) {
+				history[n][c][head % HISTORY_SIZE] = decimationSum[n][c] * scale;
+				decimationSum[n][c] = 0.f;
+			}
+		}
+		decimationCount = 0;
+		head++;
+		historyHead.store(head, std::memory_order_release);
+
+		for (int n = 0; n < 2; n++) {
+			if (capturing[n] && head - triggerHead[n] >= (uint32_t)historyLength) {
+				capturedHead[n].store(triggerHead[n] + historyLength, std::memory_order_release);
+				capturing[n] = false;
+			}
+		}
+	}
+
+	// 0-10V, one channel per probe
+	void processProbes(const ProcessArgs& args) {
+		int count = probeCount.load(std::memory_order_relaxed);
+		float coef = probeSmoothing > 0.f ? std::min(args.sampleTime / probeSmoothing, 1.f) : 1.f;
+		for (int k = 0; k < 4; k++) {
+			Output& output = outputs[OUTPUT_PROBE_R + k];
+			if (!output.isConnected()) continue;
+			output.setChannels(count);
+			if (count == 0) output.setVoltage(0.f);
+			for (int c = 0; c < count; c++) {
+				probeValues[k][c] += (probeTargets[k][c] - probeValues[k][c]) * coef;
+				output.setVoltage(probeValues[k][c] * 10.f, c);
+			}
+		}
+	}
+
+	bool isProbing() {
+		for (int k = 0; k < 4; k++) {
+			if (outputs[OUTPUT_PROBE_R + k].isConnected()) return true;
+		}
+		return false;
+	}
+
+	void onSampleRateChange(const SampleRateChangeEvent& e) override {
+		features[0].setSampleRate(e.sampleRate);
+		features[1].setSampleRate(e.sampleRate);
+	}
+
+	json_t* dataToJson() override {
+		json_t* rootJ = json_object();
+		json_object_set_new(rootJ, "historyLength", json_integer(historyLength));
+		json_object_set_new(rootJ, "decimation", json_integer(decimation));
+		json_object_set_new(rootJ, "smoothing", json_real(smoothingFactor));
+		json_object_set_new(rootJ, "triggerSync", json_boolean(triggerSync));
+		json_object_set_new(rootJ, "renderScale", json_real(renderScale));
+		json_object_set_new(rootJ, "maxFps", json_integer(maxFps));
+		json_object_set_new(rootJ, "recordFormat", json_integer(recordFormat));
+		json_object_set_new(rootJ, "spectrumSize", json_integer(spectrumSize));
+		json_object_set_new(rootJ, "spectrumResponse", json_integer(spectrumResponse));
+		json_object_set_new(rootJ, "probeSmoothing", json_real(probeSmoothing));
+		return rootJ;
+	}
+
+	void dataFromJson(json_t* rootJ) override {
+		json_t* historyLengthJ = json_object_get(rootJ, "historyLength");
+		if (historyLengthJ) {
+			historyLength = clamp((int)json_integer_value(historyLengthJ), 1, (int)HISTORY_SIZE);
+		}
+		json_t* decimationJ = json_object_get(rootJ, "decimation");
+		if (decimationJ) {
+			decimation = clamp((int)json_integer_value(decimationJ), 1, 1024);
+		}
+		json_t* smoothingJ = json_object_get(rootJ, "smoothing");
+		if (smoothingJ) {
+			smoothingFactor = clamp((float)json_number_value(smoothingJ), 0.f, 0.99f);
+		}
+		json_t* triggerSyncJ = json_object_get(rootJ, "triggerSync");
+		if (triggerSyncJ) {
+			triggerSync = json_is_true(triggerSyncJ);
+		}
+		json_t* renderScaleJ = json_object_get(rootJ, "renderScale");
+		if (renderScaleJ) {
+			renderScale = clamp((float)json_number_value(renderScaleJ), 0.f, 1.f);
+		}
+		json_t* maxFpsJ = json_object_get(rootJ, "maxFps");
+		if (maxFpsJ) {
+			maxFps = std::max((int)json_integer_value(maxFpsJ), 0);
+		}
+		json_t* recordFormatJ = json_object_get(rootJ, "recordFormat");
+		if (recordFormatJ) {
+			recordFormat = clamp((int)json_integer_value(recordFormatJ), 0, FrameRecorder::FORMATS_LEN - 1);
+		}
+		json_t* spectrumSizeJ = json_object_get(rootJ, "spectrumSize");
+		if (spectrumSizeJ) {
+			int size = clamp((int)json_integer_value(spectrumSizeJ), (int)Spectrum::MIN_SIZE, (int)Spectrum::MAX_SIZE);
+			// RealFFT wants a power of two
+			spectrumSize = Spectrum::MIN_SIZE;
+			while (spectrumSize * 2 <= size) spectrumSize *= 2;
+		}
+		json_t* spectrumResponseJ = json_object_get(rootJ, "spectrumResponse");
+		if (spectrumResponseJ) {
+			spectrumResponse = clamp((int)json_integer_value(spectrumResponseJ), 0, SPECTRUM_RESPONSES_LEN - 1);
+		}
+		json_t* probeSmoothingJ = json_object_get(rootJ, "probeSmoothing");
+		if (probeSmoothingJ) {
+			probeSmoothing = clamp((float)json_number_value(probeSmoothingJ), 0.f, 1.f);
 		}
-		audioBuffer1[0] = in1;
-		audioBuffer2[0] = in2;
 	}
 
 	void onShaderSubscribe(int64_t glibId, int shaderIndex) override {
@@ -343,97 +710,77 @@ void GLCanvasWidget::createShaderProgram() {
 
 	//INFO("Shader pair found and valid. Vertex shader length: %zu, Fragment shader length: %zu", shaderPair->vertexSource.length(), shaderPair->fragmentSource.length());
 	
-	if (shaderProgram) {
-		glDeleteProgram(shaderProgram);
-		shaderProgram = 0;
-		
-		glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	// replaces a request that is still compiling
+	shaderLib.releaseProgram(pendingProgram);
+	pendingShader = *shaderPair;
+	pendingProgram = shaderLib.acquireProgram(pendingShader.vertexSource, buildAudioShaderSource(pendingShader.fragmentSource));
+	dirty = false;
+}
+
+void GLCanvasWidget::installShaderProgram() {
+	auto& shaderLib = SharedShaderLibrary::getInstance();
+	SharedShaderLibrary::ProgramStatus status = shaderLib.getProgramStatus(pendingProgram);
+	if (status == SharedShaderLibrary::PROGRAM_PENDING) return;
+	if (status == SharedShaderLibrary::PROGRAM_FAILED) {
+		shaderLib.releaseProgram(pendingProgram);
+		pendingProgram = 0;
+		return;
 	}
+	shaderLib.releaseProgram(shaderProgram);
+	shaderProgram = pendingProgram;
+	pendingProgram = 0;
+	const ShaderPair* shaderPair = &pendingShader;
 	
-	GLuint vertShader = 0, fragShader = 0;
 	try {
-		vertShader = gl::compileShader(shaderPair->vertexSource, GL_VERTEX_SHADER);
-		if (!vertShader) {
-			WARN("Failed to compile vertex shader");
-			
-			dirty = false;
-			return;
-		}
-		
-		fragShader = gl::compileShader(shaderPair->fragmentSource, GL_FRAGMENT_SHADER);
-		if (!fragShader) {
-			WARN("Failed to compile fragment shader");
-			glDeleteShader(vertShader);
-			dirty = false;
-			return;
-		}
-		
-		shaderProgram = glCreateProgram();
-		if (!shaderProgram) {
-			WARN("Failed to create shader program");
-			glDeleteShader(vertShader);
-			glDeleteShader(fragShader);
-			dirty = false;
-			return;
-		}
-		
-		glAttachShader(shaderProgram, vertShader);
-		glAttachShader(shaderProgram, fragShader);
-		glLinkProgram(shaderProgram);
-		
-		GLint ok;
-		glGetProgramiv(shaderProgram, GL_LINK_STATUS, &ok);
-		if (!ok) {
-			GLchar infoLog[512];
-			glGetProgramInfoLog(shaderProgram, 512, nullptr, infoLog);
-			WARN("Shader program linking failed: %s", infoLog);
-			glDeleteProgram(shaderProgram);
-			shaderProgram = 0;
-			dirty = false;
-			return;
-		}
-		//INFO("Shader program linked successfully");
-		
-		glDeleteShader(vertShader);
-		glDeleteShader(fragShader);
-		
 		//INFO("Getting uniform and attribute locations...");
 		glUseProgram(shaderProgram);
 		posAttrib = glGetAttribLocation(shaderProgram, "vs_Pos");
 		texCoordAttrib = glGetAttribLocation(shaderProgram, "vs_TexCoord");
 		timeUniform = glGetUniformLocation(shaderProgram, "u_Time");
 		resolutionUniform = glGetUniformLocation(shaderProgram, "u_Resolution");
-		audioData1Uniform = glGetUniformLocation(shaderProgram, "u_AudioData1");
-		audioData2Uniform = glGetUniformLocation(shaderProgram, "u_AudioData2");
 		projUniform = glGetUniformLocation(shaderProgram, "u_Proj");
 		modelUniform = glGetUniformLocation(shaderProgram, "u_Model");
 		trigger1Uniform = glGetUniformLocation(shaderProgram, "u_Trigger1");
 		trigger2Uniform = glGetUniformLocation(shaderProgram, "u_Trigger2");
 		timeWarp1Uniform = glGetUniformLocation(shaderProgram, "u_TimeWarp1");
 		timeWarp2Uniform = glGetUniformLocation(shaderProgram, "u_TimeWarp2");
+		audioHistory1Uniform = glGetUniformLocation(shaderProgram, "u_AudioHistory1");
+		audioHistory2Uniform = glGetUniformLocation(shaderProgram, "u_AudioHistory2");
+		audioHeadUniform = glGetUniformLocation(shaderProgram, "u_AudioHead");
+		audioHead1Uniform = glGetUniformLocation(shaderProgram, "u_AudioHead1");
+		audioHead2Uniform = glGetUniformLocation(shaderProgram, "u_AudioHead2");
+		audioSizeUniform = glGetUniformLocation(shaderProgram, "u_AudioSize");
+		audioLengthUniform = glGetUniformLocation(shaderProgram, "u_AudioLength");
+		channelsUniform = glGetUniformLocation(shaderProgram, "u_Channels");
+		spectrum1Uniform = glGetUniformLocation(shaderProgram, "u_Spectrum1");
+		spectrum2Uniform = glGetUniformLocation(shaderProgram, "u_Spectrum2");
+		spectrumSizeUniform = glGetUniformLocation(shaderProgram, "u_SpectrumSize");
+		pyramid1Uniform = glGetUniformLocation(shaderProgram, "u_AudioPyramid1");
+		pyramid2Uniform = glGetUniformLocation(shaderProgram, "u_AudioPyramid2");
+		featureUniforms[0].locate(shaderProgram, 1);
+		featureUniforms[1].locate(shaderProgram, 2);
+		passUniform = glGetUniformLocation(shaderProgram, "u_Pass");
+		passCountUniform = glGetUniformLocation(shaderProgram, "u_PassCount");
+		passSizeUniform = glGetUniformLocation(shaderProgram, "u_PassSize");
+		frameUniform = glGetUniformLocation(shaderProgram, "u_Frame");
+		renderedStill = false;
 		
-		//INFO("Setting up framebuffer...");
-		setupFramebuffer();
+		//INFO("Setting up passes...");
+		setupGeometryMode(shaderPair->vertexSource);
+		setupPasses(shaderPair->fragmentSource);
+		setupProbes(shaderPair->fragmentSource);
+		setupTextures(*shaderPair);
+		setupHistoryTextures();
 		
 		//INFO("Setting up geometry...");
 		setupGeometry();
 		
-		gl::checkError("createShaderProgram");
-		//INFO("Successfully created shader program for module %lld", (long long)moduleId);
-		dirty = false;
+		gl::checkError("installShaderProgram");
 	}
 	catch (const std::exception& e) {
 		WARN("Exception during shader program creation: %s", e.what());
-		if (vertShader) glDeleteShader(vertShader);
-		if (fragShader) glDeleteShader(fragShader);
-		if (shaderProgram) {
-			glDeleteProgram(shaderProgram);
-			shaderProgram = 0;
-		}
-		dirty = false;
+		shaderLib.releaseProgram(shaderProgram);
+		shaderProgram = 0;
 	}
 }
 
@@ -449,17 +796,755 @@ void GLCanvasWidget::setupGeometry() {
 		1, 3, 2
 	};
 	
-	glGenBuffers(1, &VBO);
+	// every recompile comes through here, so the buffers are only created once
+	if (!VBO) glGenBuffers(1, &VBO);
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 	
-	glGenBuffers(1, &EBO);
+	if (!EBO) glGenBuffers(1, &EBO);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 	
 	checkGLError("setupGeometry");
 }
 
+void GLCanvasWidget::setupGeometryMode(const std::string& vertexSource) {
+	static const struct {
+		const char* name;
+		GLenum primitive;
+	} primitives[] = {
+		{"points", GL_POINTS},
+		{"lines", GL_LINES},
+		{"line_strip", GL_LINE_STRIP},
+		{"line_loop", GL_LINE_LOOP},
+		{"triangles", GL_TRIANGLES},
+		{"triangle_strip", GL_TRIANGLE_STRIP},
+	};
+	geometryPrimitive = 0;
+	geometryCount = 0;
+	geometryInstances = 1;
+	for (const gl::Pragma& pragma : gl::parsePragmas(vertexSource, "canvas")) {
+		if (pragma.directive != "geometry") continue;
+		if (pragma.args.size() < 2) {
+			WARN("GLCanvasWidget: '#pragma canvas geometry' needs <primitive> <count> [instances]");
+			continue;
+		}
+		GLenum primitive = 0;
+		for (const auto& entry : primitives) {
+			if (pragma.args[0] == entry.name) primitive = entry.primitive;
+		}
+		if (!primitive) {
+			WARN("GLCanvasWidget: Unknown geometry primitive '%s'", pragma.args[0].c_str());
+			continue;
+		}
+		geometryPrimitive = primitive;
+		geometryCount = clamp(std::atoi(pragma.args[1].c_str()), 1, (int)MAX_GEOMETRY_VERTICES);
+		if (pragma.args.size() > 2) {
+			geometryInstances = clamp(std::atoi(pragma.args[2].c_str()), 1, (int)MAX_GEOMETRY_VERTICES);
+		}
+	}
+	indexAttrib = glGetAttribLocation(shaderProgram, "vs_Index");
+	instanceAttrib = glGetAttribLocation(shaderProgram, "vs_Instance");
+	if (!geometryPrimitive) return;
+	// there is no quad to read them from, they keep their constant value
+	posAttrib = -1;
+	texCoordAttrib = -1;
+
+	// vs_Index and vs_Instance both read this 0, 1, 2, ... ramp
+	int size = std::max(geometryCount, geometryInstances);
+	if (size <= indexBufferSize) return;
+	std::vector<float> indices(size);
+	for (int i = 0; i < size; i++) indices[i] = (float)i;
+	if (!indexBuffer) glGenBuffers(1, &indexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, indexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, size * sizeof(float), indices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	indexBufferSize = size;
+	gl::checkError("setupGeometryMode");
+}
+
+// one draw of the current program: the fullscreen quad, or the declared
+// geometry. instances are drawn in one call where GL 3.3 is available
+void GLCanvasWidget::drawGeometry() {
+	if (!geometryPrimitive) {
+		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+		return;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, indexBuffer);
+	if (indexAttrib >= 0) {
+		glEnableVertexAttribArray(indexAttrib);
+		glVertexAttribPointer(indexAttrib, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)0);
+	}
+	glEnable(GL_PROGRAM_POINT_SIZE);
+	if (geometryInstances > 1 && GLEW_VERSION_3_3) {
+		if (instanceAttrib >= 0) {
+			glEnableVertexAttribArray(instanceAttrib);
+			glVertexAttribPointer(instanceAttrib, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)0);
+			glVertexAttribDivisor(instanceAttrib, 1);
+		}
+		glDrawArraysInstanced(geometryPrimitive, 0, geometryCount, geometryInstances);
+		if (instanceAttrib >= 0) {
+			glVertexAttribDivisor(instanceAttrib, 0);
+			glDisableVertexAttribArray(instanceAttrib);
+		}
+	}
+	else {
+		for (int i = 0; i < geometryInstances; i++) {
+			if (instanceAttrib >= 0) glVertexAttrib1f(instanceAttrib, (float)i);
+			glDrawArrays(geometryPrimitive, 0, geometryCount);
+		}
+	}
+	glDisable(GL_PROGRAM_POINT_SIZE);
+	if (indexAttrib >= 0) glDisableVertexAttribArray(indexAttrib);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+}
+
+void GLCanvasWidget::setupPasses(const std::string& fragmentSource) {
+	for (Pass& pass : passes) deletePass(pass);
+	passes.clear();
+	deletePass(framePass);
+	frameCount = 0;
+
+	for (const gl::Pragma& pragma : gl::parsePragmas(fragmentSource, "canvas")) {
+		if (pragma.directive != "pass") continue;
+		if (pragma.args.empty()) {
+			WARN("GLCanvasWidget: '#pragma canvas pass' needs a sampler name");
+			continue;
+		}
+		if ((int)passes.size() >= MAX_PASSES) {
+			WARN("GLCanvasWidget: Ignoring pass '%s', at most %d passes are supported", pragma.args[0].c_str(), MAX_PASSES);
+			continue;
+		}
+		Pass pass;
+		pass.name = pragma.args[0];
+		if (pragma.args.size() > 1) {
+			pass.scale = clamp((float)std::atof(pragma.args[1].c_str()), 0.125f, 1.f);
+		}
+		pass.samplerUniform = glGetUniformLocation(shaderProgram, pass.name.c_str());
+		passes.push_back(pass);
+	}
+	// textures are created by the first draw, once the canvas size is known
+	framePass.name = "u_PrevFrame";
+	framePass.samplerUniform = glGetUniformLocation(shaderProgram, "u_PrevFrame");
+}
+
+void GLCanvasWidget::setupProbes(const std::string& fragmentSource) {
+	probes.clear();
+	for (const gl::Pragma& pragma : gl::parsePragmas(fragmentSource, "canvas")) {
+		if (pragma.directive != "probe") continue;
+		if (pragma.args.size() != 2 && pragma.args.size() != 4) {
+			WARN("GLCanvasWidget: '#pragma canvas probe' needs <x> <y> [width height]");
+			continue;
+		}
+		if ((int)probes.size() >= MAX_PROBES) {
+			WARN("GLCanvasWidget: Ignoring probe, at most %d probes are supported", (int)MAX_PROBES);
+			continue;
+		}
+		Probe probe;
+		probe.x = clamp((float)std::atof(pragma.args[0].c_str()), 0.f, 1.f);
+		probe.y = clamp((float)std::atof(pragma.args[1].c_str()), 0.f, 1.f);
+		if (pragma.args.size() == 4) {
+			probe.width = clamp((float)std::atof(pragma.args[2].c_str()), 0.f, 1.f - probe.x);
+			probe.height = clamp((float)std::atof(pragma.args[3].c_str()), 0.f, 1.f - probe.y);
+		}
+		probes.push_back(probe);
+	}
+	if (module) module->probeCount = (int)probes.size();
+}
+
+void GLCanvasWidget::setupTextures(const ShaderPair& shaderPair) {
+	for (int i = 0; i < MAX_TEXTURES; i++) {
+		textures[i] = nullptr;
+		textureUniforms[i] = glGetUniformLocation(shaderProgram, string::f("u_Texture%d", i).c_str());
+	}
+	// the pair's name is its path without the extension. pairs published from
+	// GLAB have no path, so theirs start at the plugin's user folder
+	std::string directory = system::getDirectory(shaderPair.name);
+	if (directory.empty()) directory = asset::user(pluginInstance->slug);
+	for (const std::string& source : {shaderPair.vertexSource, shaderPair.fragmentSource}) {
+		for (const gl::Pragma& pragma : gl::parsePragmas(source, "canvas")) {
+			if (pragma.directive != "texture") continue;
+			if (pragma.args.size() != 2) {
+				WARN("GLCanvasWidget: '#pragma canvas texture' needs <0-%d> <path>", MAX_TEXTURES - 1);
+				continue;
+			}
+			int index = std::atoi(pragma.args[0].c_str());
+			if (index < 0 || index >= MAX_TEXTURES) {
+				WARN("GLCanvasWidget: Ignoring texture %d, only u_Texture0-%d are supported", index, MAX_TEXTURES - 1);
+				continue;
+			}
+			textures[index] = TextureCache::getInstance().acquire(system::join(directory, pragma.args[1]));
+		}
+	}
+}
+
+bool GLCanvasWidget::isLoadingTextures() const {
+	for (const TextureCache::Handle& texture : textures) {
+		if (texture && texture->isPending()) return true;
+	}
+	return false;
+}
+
+// x, y, width, height in pixels of a width x height frame, at least one pixel
+void GLCanvasWidget::getProbeRect(const Probe& probe, int width, int height, int* rect) const {
+	int x0 = clamp((int)(probe.x * width), 0, width - 1);
+	int y0 = clamp((int)(probe.y * height), 0, height - 1);
+	int x1 = clamp((int)std::ceil((probe.x + probe.width) * width), x0 + 1, width);
+	int y1 = clamp((int)std::ceil((probe.y + probe.height) * height), y0 + 1, height);
+	rect[0] = x0;
+	rect[1] = y0;
+	rect[2] = x1 - x0;
+	rect[3] = y1 - y0;
+}
+
+// reads the bounding box of all probes from the framebuffer just drawn.
+// a frame whose readback can't get a buffer is simply not probed
+void GLCanvasWidget::readProbes(int width, int height) {
+	if (probes.empty() || !module->isProbing()) return;
+	int x0 = width, y0 = height, x1 = 0, y1 = 0;
+	for (const Probe& probe : probes) {
+		int rect[4];
+		getProbeRect(probe, width, height, rect);
+		x0 = std::min(x0, rect[0]);
+		y0 = std::min(y0, rect[1]);
+		x1 = std::max(x1, rect[0] + rect[2]);
+		y1 = std::max(y1, rect[1] + rect[3]);
+	}
+	probeReadback.read(x0, y0, x1 - x0, y1 - y0, width, height);
+	gl::checkError("readProbes");
+}
+
+// averages each probe's region of the finished readbacks into the module's targets
+void GLCanvasWidget::collectProbes() {
+	probeReadback.collect([&](const gl::ReadbackRing::Buffer& buffer, const uint8_t* pixels) {
+		if (!pixels || !module) return;
+		int count = std::min((int)probes.size(), (int)MAX_PROBES);
+		for (int c = 0; c < count; c++) {
+			int rect[4];
+			getProbeRect(probes[c], buffer.frameWidth, buffer.frameHeight, rect);
+			// the probes may have changed since the read, keep to what was read
+			int x0 = clamp(rect[0] - buffer.x, 0, buffer.width - 1);
+			int y0 = clamp(rect[1] - buffer.y, 0, buffer.height - 1);
+			int x1 = clamp(rect[0] + rect[2] - buffer.x, x0 + 1, buffer.width);
+			int y1 = clamp(rect[1] + rect[3] - buffer.y, y0 + 1, buffer.height);
+			uint32_t sums[4] = {0, 0, 0, 0};
+			for (int y = y0; y < y1; y++) {
+				const uint8_t* row = pixels + ((size_t)y * buffer.width + x0) * 4;
+				for (int x = 0; x < x1 - x0; x++) {
+					for (int k = 0; k < 4; k++) sums[k] += row[x * 4 + k];
+				}
+			}
+			float scale = 1.f / (255.f * (x1 - x0) * (y1 - y0));
+			for (int k = 0; k < 4; k++) {
+				module->probeTargets[k][c] = sums[k] * scale;
+			}
+		}
+	});
+}
+
+// (re)creates the pass's textures when the canvas size has changed. they start
+// out zeroed, so feedback restarts from black after a resize
+void GLCanvasWidget::resizePass(Pass& pass, int width, int height) {
+	width = std::max((int)std::round(width * pass.scale), 1);
+	height = std::max((int)std::round(height * pass.scale), 1);
+	if (pass.textures[0] && pass.width == width && pass.height == height) return;
+
+	if (!pass.textures[0]) {
+		glGenTextures(2, pass.textures);
+		glGenFramebuffers(2, pass.frameBuffers);
+	}
+	pass.width = width;
+	pass.height = height;
+	pass.readIndex = 0;
+	for (int i = 0; i < 2; i++) {
+		// half floats: plenty for colors and trails at half the bandwidth of GLAZE's state
+		glBindTexture(GL_TEXTURE_2D, pass.textures[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, pass.frameBuffers[i]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pass.textures[i], 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			WARN("GLCanvasWidget: Framebuffer for pass '%s' is not complete", pass.name.c_str());
+		}
+		glClearColor(0.f, 0.f, 0.f, 0.f);
+		glClear(GL_COLOR_BUFFER_BIT);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	gl::checkError("resizePass");
+}
+
+void GLCanvasWidget::deletePass(Pass& pass) {
+	if (pass.textures[0]) glDeleteTextures(2, pass.textures);
+	if (pass.frameBuffers[0]) glDeleteFramebuffers(2, pass.frameBuffers);
+	pass.textures[0] = pass.textures[1] = 0;
+	pass.frameBuffers[0] = pass.frameBuffers[1] = 0;
+}
+
+// binds the newest texture of every pass, and the previous frame, from PASS_TEXTURE_UNIT up
+void GLCanvasWidget::bindPassTextures() {
+	for (size_t i = 0; i <= passes.size(); i++) {
+		Pass& pass = i < passes.size() ? passes[i] : framePass;
+		if (pass.samplerUniform < 0 || !pass.textures[0]) continue;
+		glActiveTexture(GL_TEXTURE0 + PASS_TEXTURE_UNIT + i);
+		glBindTexture(GL_TEXTURE_2D, pass.textures[pass.readIndex]);
+		glUniform1i(pass.samplerUniform, PASS_TEXTURE_UNIT + i);
+	}
+	glActiveTexture(GL_TEXTURE0);
+}
+
+// renders the declared passes and then the visible one into the framebuffer
+// that was bound on entry, which is bound again on return. blending only
+// applies to the visible pass, the others store raw values
+void GLCanvasWidget::drawPasses(int width, int height) {
+	GLint target = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &target);
+	GLboolean blend = glIsEnabled(GL_BLEND);
+	if (passCountUniform >= 0) glUniform1i(passCountUniform, (int)passes.size());
+	if (frameUniform >= 0) glUniform1i(frameUniform, frameCount);
+
+	glDisable(GL_BLEND);
+	for (size_t i = 0; i < passes.size(); i++) {
+		Pass& pass = passes[i];
+		resizePass(pass, width, height);
+		int writeIndex = 1 - pass.readIndex;
+
+		bindPassTextures();
+		glBindFramebuffer(GL_FRAMEBUFFER, pass.frameBuffers[writeIndex]);
+		glViewport(0, 0, pass.width, pass.height);
+		if (passUniform >= 0) glUniform1i(passUniform, (int)i);
+		if (passSizeUniform >= 0) glUniform2f(passSizeUniform, (float)pass.width, (float)pass.height);
+		drawGeometry();
+
+		pass.readIndex = writeIndex;
+	}
+	if (blend) glEnable(GL_BLEND);
+
+	bool keepFrame = framePass.samplerUniform >= 0;
+	if (keepFrame) resizePass(framePass, width, height);
+	bindPassTextures();
+	if (passUniform >= 0) glUniform1i(passUniform, (int)passes.size());
+	if (passSizeUniform >= 0) glUniform2f(passSizeUniform, (float)width, (float)height);
+	if (keepFrame) {
+		int writeIndex = 1 - framePass.readIndex;
+		glBindFramebuffer(GL_FRAMEBUFFER, framePass.frameBuffers[writeIndex]);
+		glViewport(0, 0, width, height);
+		glClearColor(0.f, 0.f, 0.f, 1.f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		drawGeometry();
+
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, framePass.frameBuffers[writeIndex]);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+		glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		framePass.readIndex = writeIndex;
+	}
+	else {
+		glBindFramebuffer(GL_FRAMEBUFFER, target);
+		glViewport(0, 0, width, height);
+		drawGeometry();
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, target);
+	glViewport(0, 0, width, height);
+	for (size_t i = 0; i <= passes.size(); i++) {
+		glActiveTexture(GL_TEXTURE0 + PASS_TEXTURE_UNIT + i);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	glActiveTexture(GL_TEXTURE0);
+	frameCount++;
+	gl::checkError("drawPasses");
+}
+
+// `path` without extension, see FrameRecorder::start()
+void GLCanvasWidget::startRecording(const std::string& path) {
+	stopRecording();
+	// the FPS cap is the best guess for the frame rate of the stream
+	int fps = module->maxFps > 0 ? module->maxFps : 60;
+	recorder = FrameRecorder::start(path, (FrameRecorder::Format)module->recordFormat, fps);
+	INFO("GLCanvasWidget: Recording to %s", path.c_str());
+}
+
+// frames still in flight are collected, and then dropped, by later draws
+void GLCanvasWidget::stopRecording() {
+	if (!recorder) return;
+	recorder->stop();
+	recorder = nullptr;
+}
+
+void GLCanvasWidget::captureFrame(int width, int height) {
+	if (!recordReadback.read(0, 0, width, height, width, height)) {
+		recorder->dropFrame();
+	}
+	gl::checkError("captureFrame");
+}
+
+// hands finished readbacks to the recorder. after a stop they are just released
+void GLCanvasWidget::collectFrames() {
+	recordReadback.collect([&](const gl::ReadbackRing::Buffer& buffer, const uint8_t* pixels) {
+		if (!recorder) return;
+		if (!pixels) {
+			recorder->dropFrame();
+			return;
+		}
+		FrameRecorder::Frame frame = recorder->takeFreeFrame();
+		frame.width = buffer.width;
+		frame.height = buffer.height;
+		frame.pixels.assign(pixels, pixels + (size_t)buffer.width * buffer.height * 4);
+		recorder->push(std::move(frame));
+	});
+}
+
+void GLCanvasWidget::setupHistoryTextures() {
+	if (historyTextures[0]) {
+		glDeleteTextures(2, historyTextures);
+		historyTextures[0] = historyTextures[1] = 0;
+	}
+	glGenTextures(2, historyTextures);
+	// zeroed, since rows of unused channels are never uploaded
+	uploadBuffer.assign((size_t)PORT_MAX_CHANNELS * Canvas::HISTORY_SIZE, 0.f);
+	for (int i = 0; i < 2; i++) {
+		glBindTexture(GL_TEXTURE_2D, historyTextures[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, Canvas::HISTORY_SIZE, PORT_MAX_CHANNELS, 0, GL_RED, GL_FLOAT, uploadBuffer.data());
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	// the first upload fills the whole ring
+	uploadedHead = module ? module->historyHead.load() - Canvas::HISTORY_SIZE : 0;
+	uploadRows[0] = uploadRows[1] = 1;
+	gl::checkError("setupHistoryTextures");
+}
+
+// smooths the entries written since the last frame and copies them into the
+// ring textures, in at most two pieces when they wrap around the end
+void GLCanvasWidget::uploadHistory() {
+	uint32_t head = module->historyHead.load(std::memory_order_acquire);
+	uint32_t count = std::min(head - uploadedHead, (uint32_t)Canvas::HISTORY_SIZE);
+	uint32_t start = head - count;
+	float smoothing = module->smoothingFactor;
+	uploadRows[0] = std::max(uploadRows[0], module->ch1);
+	uploadRows[1] = std::max(uploadRows[1], module->ch2);
+	while (count > 0) {
+		int offset = start % Canvas::HISTORY_SIZE;
+		int length = std::min((int)count, Canvas::HISTORY_SIZE - offset);
+		for (int i = 0; i < 2; i++) {
+			for (int c = 0; c < uploadRows[i]; c++) {
+				const float* entries = &module->history[i][c][offset];
+				float* row = &uploadBuffer[(size_t)c * length];
+				for (int j = 0; j < length; j++) {
+					smoothed[i][c] = smoothed[i][c] * smoothing + entries[j] * (1.f - smoothing);
+					row[j] = smoothed[i][c];
+				}
+			}
+			glBindTexture(GL_TEXTURE_2D, historyTextures[i]);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, offset, 0, length, uploadRows[i], GL_RED, GL_FLOAT, uploadBuffer.data());
+		}
+		start += length;
+		count -= length;
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	uploadedHead = head;
+}
+
+// the newest entry input n's display ends at: the last completed triggered
+// capture with trigger sync on, as long as the ring still holds all of it
+uint32_t GLCanvasWidget::getDisplayHead(int input) const {
+	if (!module->triggerSync) return uploadedHead;
+	uint32_t captured = module->capturedHead[input].load(std::memory_order_acquire);
+	if (!captured || uploadedHead - captured > (uint32_t)(Canvas::HISTORY_SIZE - module->historyLength)) {
+		return uploadedHead;
+	}
+	return captured;
+}
+
+// windowed FFT of the newest `size` entries of each input. runs on the Worker
+static void buildSpectrum(std::shared_ptr<SpectrumSlot> slot, std::vector<float> entries, int size, float entryRate, int response) {
+	const int bins = size / 2;
+	Spectrum* result = new Spectrum;
+	result->bins = bins;
+
+	dsp::RealFFT fft(size);
+	float* frame = (float*)pffft_aligned_malloc(size * sizeof(float));
+	float* spectrum = (float*)pffft_aligned_malloc(size * sizeof(float));
+	std::vector<float> levels(bins);
+	// Hann window, scaled so a full-scale sine peaks at 1
+	float gain = 4.f / size;
+	float binHz = entryRate / size;
+	float logSpan = std::log2(std::max(entryRate / 2.f, 40.f) / 20.f);
+	result->settled = true;
+
+	for (int input = 0; input < 2; input++) {
+		const float* samples = &entries[(size_t)input * size];
+		for (int i = 0; i < size; i++) {
+			float window = 0.5f - 0.5f * std::cos(2.f * M_PI * i / size);
+			frame[i] = samples[i] * window;
+		}
+		fft.rfft(frame, spectrum);
+		// pffft packs DC and Nyquist into bin 0, then (re, im) pairs
+		for (int k = 0; k < bins; k++) {
+			float magnitude = k == 0 ? std::fabs(spectrum[0]) * 0.5f : std::hypot(spectrum[2 * k], spectrum[2 * k + 1]);
+			float db = 20.f * std::log10(magnitude * gain + 1e-9f);
+			levels[k] = clamp(db / 90.f + 1.f, 0.f, 1.f);
+		}
+
+		std::vector<float>& row = result->rows[input];
+		row.resize((size_t)2 * bins);
+		std::copy(levels.begin(), levels.end(), row.begin());
+		for (int t = 0; t < bins; t++) {
+			float frequency = 20.f * std::exp2(logSpan * t / (bins - 1));
+			float bin = std::min(frequency / binHz, (float)(bins - 1));
+			int k = std::min((int)bin, bins - 2);
+			row[bins + t] = crossfade(levels[k], levels[k + 1], bin - k);
+		}
+
+		std::vector<float>& previous = slot->previous[input];
+		if (previous.size() == row.size()) {
+			for (size_t i = 0; i < row.size(); i++) {
+				if (response == SPECTRUM_SMOOTH) {
+					row[i] = previous[i] * 0.8f + row[i] * 0.2f;
+				}
+				else if (response == SPECTRUM_PEAK_HOLD) {
+					row[i] = std::max(row[i], previous[i] - 0.005f);
+				}
+				if (std::fabs(row[i] - previous[i]) >= 1e-4f) result->settled = false;
+			}
+		}
+		else {
+			result->settled = false;
+		}
+		previous = row;
+	}
+	pffft_aligned_free(frame);
+	pffft_aligned_free(spectrum);
+
+	slot->publish(result);
+	slot->building = false;
+}
+
+// hands the newest spectrumSize entries of both inputs to the Worker, unless
+// a spectrum is still being built or nothing new has arrived. reads the raw
+// ring, so the spectrum doesn't depend on the display smoothing
+void GLCanvasWidget::requestSpectrum() {
+	uint32_t head = module->historyHead.load(std::memory_order_acquire);
+	if (head == spectrumHead || spectrumSlot->building) return;
+	spectrumHead = head;
+
+	int size = module->spectrumSize;
+	std::vector<float> entries((size_t)2 * size);
+	for (int input = 0; input < 2; input++) {
+		for (int i = 0; i < size; i++) {
+			entries[(size_t)input * size + i] = module->history[input][0][(head - size + i) % Canvas::HISTORY_SIZE];
+		}
+	}
+	float entryRate = APP->engine->getSampleRate() / module->decimation;
+	int response = module->spectrumResponse;
+
+	spectrumSlot->building = true;
+	std::shared_ptr<SpectrumSlot> slot = spectrumSlot;
+	Worker::getInstance().push([slot, entries, size, entryRate, response]() {
+		buildSpectrum(slot, entries, size, entryRate, response);
+	});
+}
+
+// uploads the newest finished spectrum, resizing the textures when the FFT
+// size has changed
+void GLCanvasWidget::uploadSpectrum() {
+	if (!spectrumSlot->take(spectrum)) return;
+	int bins = spectrum->bins;
+	if (!spectrumTextures[0]) {
+		glGenTextures(2, spectrumTextures);
+	}
+	for (int i = 0; i < 2; i++) {
+		glBindTexture(GL_TEXTURE_2D, spectrumTextures[i]);
+		if (bins != spectrumTextureBins) {
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, bins, 2, 0, GL_RED, GL_FLOAT, spectrum->rows[i].data());
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+		else {
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, bins, 2, GL_RED, GL_FLOAT, spectrum->rows[i].data());
+		}
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	spectrumTextureBins = bins;
+	gl::checkError("uploadSpectrum");
+}
+
+// folds `count` new entries of both inputs, starting at ring position `start`,
+// into the pyramid: level 0 takes the entries, every level above recomputes
+// just the texels over the ones that changed below. runs on the Worker
+static void updatePyramid(std::shared_ptr<PyramidSlot> slot, std::vector<float> entries, int start, int count) {
+	const int levels = PyramidUpdate::LEVELS;
+	PyramidUpdate* update = new PyramidUpdate;
+	for (int input = 0; input < 2; input++) {
+		for (int level = 0; level < levels; level++) {
+			int width = Canvas::HISTORY_SIZE >> level;
+			std::vector<float>& texels = slot->levels[input][level];
+			if (texels.empty()) texels.assign((size_t)width * 3, 0.f);
+			int first = start >> level;
+			int changed = std::min(((start + count - 1) >> level) - first + 1, width);
+
+			for (int j = 0; j < changed; j++) {
+				int i = (first + j) % width;
+				float* texel = &texels[(size_t)i * 3];
+				if (level == 0) {
+					float x = entries[(size_t)input * count + j];
+					texel[0] = x;
+					texel[1] = x;
+					texel[2] = x * x;
+				}
+				else {
+					const float* children = &slot->levels[input][level - 1][(size_t)i * 6];
+					texel[0] = std::min(children[0], children[3]);
+					texel[1] = std::max(children[1], children[4]);
+					texel[2] = (children[2] + children[5]) * 0.5f;
+				}
+			}
+
+			update->start[level] = first % width;
+			update->count[level] = changed;
+			std::vector<float>& out = update->texels[input][level];
+			out.resize((size_t)changed * 3);
+			for (int j = 0; j < changed; j++) {
+				int i = (first + j) % width;
+				std::copy(&texels[(size_t)i * 3], &texels[(size_t)i * 3 + 3], &out[(size_t)j * 3]);
+			}
+		}
+	}
+	slot->publish(update);
+	slot->building = false;
+}
+
+// hands the entries written since the last request to the Worker, once the
+// previous update has been uploaded. reads the raw ring, like the spectrum
+void GLCanvasWidget::requestPyramid() {
+	uint32_t head = module->historyHead.load(std::memory_order_acquire);
+	if (head == pyramidHead || pyramidSlot->building || pyramidSlot->next.load()) return;
+	int count = (int)std::min(head - pyramidHead, (uint32_t)Canvas::HISTORY_SIZE);
+	uint32_t start = head - count;
+	pyramidHead = head;
+
+	std::vector<float> entries((size_t)2 * count);
+	for (int input = 0; input < 2; input++) {
+		for (int i = 0; i < count; i++) {
+			entries[(size_t)input * count + i] = module->history[input][0][(start + i) % Canvas::HISTORY_SIZE];
+		}
+	}
+	int offset = start % Canvas::HISTORY_SIZE;
+
+	pyramidSlot->building = true;
+	std::shared_ptr<PyramidSlot> slot = pyramidSlot;
+	Worker::getInstance().push([slot, entries, offset, count]() {
+		updatePyramid(slot, entries, offset, count);
+	});
+}
+
+// copies the texels of the newest update into the pyramid textures, in at
+// most two pieces per level when they wrap around
+void GLCanvasWidget::uploadPyramid() {
+	if (!pyramidTextures[0]) {
+		glGenTextures(2, pyramidTextures);
+		std::vector<float> zeros((size_t)Canvas::HISTORY_SIZE * PyramidUpdate::LEVELS * 3, 0.f);
+		for (int i = 0; i < 2; i++) {
+			glBindTexture(GL_TEXTURE_2D, pyramidTextures[i]);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, Canvas::HISTORY_SIZE, PyramidUpdate::LEVELS, 0, GL_RGB, GL_FLOAT, zeros.data());
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+	}
+	if (!pyramidSlot->take(pyramidUpdate)) return;
+	for (int i = 0; i < 2; i++) {
+		glBindTexture(GL_TEXTURE_2D, pyramidTextures[i]);
+		for (int level = 0; level < PyramidUpdate::LEVELS; level++) {
+			int width = Canvas::HISTORY_SIZE >> level;
+			int start = pyramidUpdate->start[level];
+			int count = pyramidUpdate->count[level];
+			const float* texels = pyramidUpdate->texels[i][level].data();
+			int length = std::min(count, width - start);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, start, level, length, 1, GL_RGB, GL_FLOAT, texels);
+			if (length < count) {
+				glTexSubImage2D(GL_TEXTURE_2D, 0, 0, level, count - length, 1, GL_RGB, GL_FLOAT, texels + (size_t)length * 3);
+			}
+		}
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	gl::checkError("uploadPyramid");
+}
+
+// shaders written for the old `uniform float u_AudioDataN[256]` arrays read the
+// history textures instead: entry i becomes the sample i * u_AudioLength / 256
+// samples before the newest one
+std::string GLCanvasWidget::buildAudioShaderSource(const std::string& fragmentSource) {
+	std::string versionLine;
+	std::string body = glsl::splitVersion(fragmentSource, versionLine);
+	const char* lookup = glsl::versionNumber(versionLine) >= 130 ? "texture" : "texture2D";
+
+	std::string declarations;
+	std::string helpers;
+	for (int n = 1; n <= 2; n++) {
+		std::string array = string::f("u_AudioData%d", n);
+		int size = glsl::removeUniformArray(body, array);
+		if (!size) continue;
+		std::string sampler = string::f("u_AudioHistory%d", n);
+		std::string function = string::f("canvas_AudioData%d", n);
+		glsl::replaceIndexing(body, array, function);
+		if (!glsl::containsIdentifier(body, sampler)) {
+			declarations += "uniform sampler2D " + sampler + ";\n";
+		}
+		helpers += string::f(
+			"float %s(float i) {\n"
+			"    float texel = mod(u_AudioHead%d - floor(i) * u_AudioLength / %d.0, u_AudioSize);\n"
+			"    return %s(%s, vec2((floor(texel) + 0.5) / u_AudioSize, 0.5 / %d.0)).r;\n"
+			"}\n", function.c_str(), n, size, lookup, sampler.c_str(), PORT_MAX_CHANNELS);
+	}
+	// canvas_AudioRangeN(newest, oldest): (min, max, RMS) of input n over the
+	// entries `newest` to `oldest` steps back from u_AudioHeadN, read from the
+	// pyramid level whose texels are about as long as the range. it covers the
+	// range with at most three texels, so it may reach a little past either end
+	for (int n = 1; n <= 2; n++) {
+		std::string function = string::f("canvas_AudioRange%d", n);
+		if (!glsl::containsIdentifier(body, function)) continue;
+		std::string sampler = string::f("u_AudioPyramid%d", n);
+		if (!glsl::containsIdentifier(body, sampler)) {
+			declarations += "uniform sampler2D " + sampler + ";\n";
+		}
+		helpers += string::f(
+			"vec3 %s(float newest, float oldest) {\n"
+			"    float level = clamp(floor(log2(max(oldest - newest, 1.0))), 0.0, %d.0);\n"
+			"    float block = exp2(level);\n"
+			"    float first = floor((u_AudioHead%d - floor(oldest)) / block);\n"
+			"    float last = floor((u_AudioHead%d - floor(newest)) / block);\n"
+			"    vec3 range = vec3(1e9, -1e9, 0.0);\n"
+			"    float texels = 0.0;\n"
+			"    for (int i = 0; i < 3; i++) {\n"
+			"        float b = first + float(i);\n"
+			"        if (b > last) break;\n"
+			"        vec3 t = %s(%s, vec2((mod(b, u_AudioSize / block) + 0.5) / u_AudioSize, (level + 0.5) / %d.0)).rgb;\n"
+			"        range = vec3(min(range.x, t.x), max(range.y, t.y), range.z + t.z);\n"
+			"        texels += 1.0;\n"
+			"    }\n"
+			"    return vec3(range.xy, sqrt(range.z / texels));\n"
+			"}\n", function.c_str(), (int)PyramidUpdate::LEVELS - 1, n, n, lookup, sampler.c_str(), (int)PyramidUpdate::LEVELS);
+	}
+	if (helpers.empty()) {
+		return fragmentSource;
+	}
+	for (const char* name : {"u_AudioHead1", "u_AudioHead2", "u_AudioSize", "u_AudioLength"}) {
+		if (!glsl::containsIdentifier(body, name)) {
+			declarations += std::string("uniform float ") + name + ";\n";
+		}
+	}
+	return versionLine + "\n" + declarations + helpers + body;
+}
+
 void GLCanvasWidget::step() {
 	if (!initialized) {
 		INFO("GLCanvasWidget: Initializing OpenGL context");
@@ -468,14 +1553,170 @@ void GLCanvasWidget::step() {
 		return;
 	}
 	
+	if (isHidden()) {
+		if (!released && system::getTime() - lastDrawTime > RELEASE_SECONDS) {
+			releaseResources();
+		}
+		FramebufferWidget::step();
+		return;
+	}
+	if (released) {
+		released = false;
+		dirty = true;
+	}
+
+	CompileQueue::getInstance().update();
 	if (dirty) {
 		//INFO("GLCanvasWidget: Creating shader program due to dirty flag");
 		createShaderProgram();
 	}
+	if (pendingProgram) {
+		installShaderProgram();
+	}
 	
+	// OpenGlWidget::step() redraws unconditionally. skipping it keeps the last
+	// frame, which FramebufferWidget still redraws on its own after a zoom
+	if (!shouldRender()) {
+		FramebufferWidget::step();
+		return;
+	}
+	if (module) {
+		oversample = module->renderScale > 0.f ? module->renderScale : autoScale;
+	}
 	OpenGlWidget::step();
 }
 
+void GLCanvasWidget::draw(const DrawArgs& args) {
+	lastDrawTime = system::getTime();
+	OpenGlWidget::draw(args);
+}
+
+bool GLCanvasWidget::isHidden() const {
+	if (recorder || (module && module->isProbing())) return false;
+	return system::getTime() - lastDrawTime > HIDDEN_SECONDS;
+}
+
+// everything but the recorder and the CPU-side state, which rebuilding the
+// shader doesn't recreate
+void GLCanvasWidget::releaseResources() {
+	SharedShaderLibrary::getInstance().releaseProgram(shaderProgram);
+	shaderProgram = 0;
+	SharedShaderLibrary::getInstance().releaseProgram(pendingProgram);
+	pendingProgram = 0;
+	if (VBO) glDeleteBuffers(1, &VBO);
+	if (EBO) glDeleteBuffers(1, &EBO);
+	if (indexBuffer) glDeleteBuffers(1, &indexBuffer);
+	VBO = EBO = indexBuffer = 0;
+	indexBufferSize = 0;
+	for (Pass& pass : passes) deletePass(pass);
+	passes.clear();
+	deletePass(framePass);
+	if (historyTextures[0]) glDeleteTextures(2, historyTextures);
+	if (spectrumTextures[0]) glDeleteTextures(2, spectrumTextures);
+	if (pyramidTextures[0]) glDeleteTextures(2, pyramidTextures);
+	historyTextures[0] = historyTextures[1] = 0;
+	spectrumTextures[0] = spectrumTextures[1] = 0;
+	pyramidTextures[0] = pyramidTextures[1] = 0;
+	spectrumTextureBins = 0;
+	pyramidHead = 0;
+	if (timerQuery) glDeleteQueries(1, &timerQuery);
+	timerQuery = 0;
+	timerPending = false;
+	recordReadback.release();
+	probeReadback.release();
+	for (TextureCache::Handle& texture : textures) texture = nullptr;
+	deleteFramebuffer();
+	released = true;
+	//INFO("GLCanvasWidget: Released GPU resources while off-screen");
+}
+
+// estimated bytes of textures and buffers held, images counted in full even
+// when other modules share them
+size_t GLCanvasWidget::getGpuMemory() {
+	if (released) return 0;
+	math::Vec size = getFramebufferSize();
+	size_t bytes = (size_t)size.x * size.y * 4;
+	if (historyTextures[0]) bytes += (size_t)2 * Canvas::HISTORY_SIZE * PORT_MAX_CHANNELS * 4;
+	if (pyramidTextures[0]) bytes += (size_t)2 * Canvas::HISTORY_SIZE * PyramidUpdate::LEVELS * 12;
+	bytes += (size_t)2 * spectrumTextureBins * 2 * 4;
+	bytes += (size_t)indexBufferSize * 4 + (VBO ? 20 * 4 : 0) + (EBO ? 6 * 4 : 0);
+	for (size_t i = 0; i <= passes.size(); i++) {
+		const Pass& pass = i < passes.size() ? passes[i] : framePass;
+		if (pass.textures[0]) bytes += (size_t)2 * pass.width * pass.height * 8;
+	}
+	bytes += recordReadback.getMemory() + probeReadback.getMemory();
+	for (const TextureCache::Handle& texture : textures) {
+		// plus a third for the mipmaps
+		if (texture) bytes += (size_t)texture->width * texture->height * 4 * 4 / 3;
+	}
+	return bytes;
+}
+
+// whether this UI frame should redraw: not faster than the FPS cap, and not
+// again once a frame has been drawn from inputs that can't change the picture
+// (both inputs silent, no u_Time, knobs and triggers where they were)
+bool GLCanvasWidget::shouldRender() {
+	if (!module || !shaderProgram) return true;
+
+	double now = system::getTime();
+	const float silence = 1e-4f;
+	if (module->features[0].peak >= silence || module->features[1].peak >= silence) lastSoundTime = now;
+	if (module->maxFps > 0 && now - lastRenderTime < 1.0 / module->maxFps) return false;
+
+	// the history keeps scrolling after the inputs fall silent, until the last
+	// sound has left the displayed span
+	double historySeconds = (double)module->historyLength * module->decimation / APP->engine->getSampleRate();
+	// smoothing and peak hold keep moving the spectrum after that
+	bool spectrumMoving = (spectrum1Uniform >= 0 || spectrum2Uniform >= 0)
+		&& module->spectrumResponse != SPECTRUM_RAW
+		&& (!spectrum || !spectrum->settled);
+	bool still = timeUniform < 0
+		&& !recorder
+		&& passes.empty()
+		&& probes.empty()
+		&& !isLoadingTextures()
+		&& framePass.samplerUniform < 0
+		&& now - lastSoundTime >= historySeconds
+		&& !spectrumMoving
+		&& module->timeWarp1 == renderedTimeWarp[0]
+		&& module->timeWarp2 == renderedTimeWarp[1]
+		&& module->trig1 == renderedTrigger[0]
+		&& module->trig2 == renderedTrigger[1];
+	if (still && renderedStill) return false;
+
+	renderedStill = still;
+	renderedTimeWarp[0] = module->timeWarp1;
+	renderedTimeWarp[1] = module->timeWarp2;
+	renderedTrigger[0] = module->trig1;
+	renderedTrigger[1] = module->trig2;
+	lastRenderTime = now;
+	return true;
+}
+
+// picks up the GPU time of an earlier frame once the driver has it (without
+// waiting) and steers autoScale to keep the shader within its budget. the cost
+// grows with the square of the scale, so small steps are enough
+void GLCanvasWidget::readGpuTime() {
+	if (!timerPending) return;
+	GLint available = 0;
+	glGetQueryObjectiv(timerQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available) return;
+	GLuint64 nanoseconds = 0;
+	glGetQueryObjectui64v(timerQuery, GL_QUERY_RESULT, &nanoseconds);
+	timerPending = false;
+	// a recording keeps the size of its first frame
+	if (recorder) return;
+
+	const float budgetMs = 4.f;
+	float gpuMs = nanoseconds * 1e-6f;
+	if (gpuMs > budgetMs) {
+		autoScale = std::max(autoScale * 0.85f, 0.25f);
+	}
+	else if (gpuMs < budgetMs * 0.5f) {
+		autoScale = std::min(autoScale * 1.05f, 1.f);
+	}
+}
+
 void GLCanvasWidget::drawFramebuffer() {
 	if (!initialized) {
 		INFO("GLCanvasWidget: OpenGL context not initialized yet");
@@ -507,6 +1748,12 @@ void GLCanvasWidget::drawFramebuffer() {
 	
 	glUseProgram(shaderProgram);
 	checkGLError("glUseProgram");
+
+	if (!timerQuery && (GLEW_VERSION_3_3 || GLEW_ARB_timer_query)) {
+		glGenQueries(1, &timerQuery);
+	}
+	readGpuTime();
+	bool timing = timerQuery && !timerPending;
 	
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
@@ -526,8 +1773,68 @@ void GLCanvasWidget::drawFramebuffer() {
 	if (resolutionUniform >= 0) glUniform2f(resolutionUniform, fbSize.x, fbSize.y);
 	
 	if (module) {
-		if (audioData1Uniform >= 0) glUniform1fv(audioData1Uniform, 256, module->audioBuffer1);
-		if (audioData2Uniform >= 0) glUniform1fv(audioData2Uniform, 256, module->audioBuffer2);
+		// the pyramid helpers need u_AudioHeadN, which follow the history upload
+		bool pyramid = pyramid1Uniform >= 0 || pyramid2Uniform >= 0;
+		if (historyTextures[0] && (audioHistory1Uniform >= 0 || audioHistory2Uniform >= 0 || pyramid)) {
+			uploadHistory();
+			if (audioHistory1Uniform >= 0) {
+				glActiveTexture(GL_TEXTURE0);
+				glBindTexture(GL_TEXTURE_2D, historyTextures[0]);
+				glUniform1i(audioHistory1Uniform, 0);
+			}
+			if (audioHistory2Uniform >= 0) {
+				glActiveTexture(GL_TEXTURE1);
+				glBindTexture(GL_TEXTURE_2D, historyTextures[1]);
+				glUniform1i(audioHistory2Uniform, 1);
+			}
+			glActiveTexture(GL_TEXTURE0);
+		}
+		if (spectrum1Uniform >= 0 || spectrum2Uniform >= 0) {
+			requestSpectrum();
+			uploadSpectrum();
+			if (spectrumTextures[0]) {
+				if (spectrum1Uniform >= 0) {
+					glActiveTexture(GL_TEXTURE2);
+					glBindTexture(GL_TEXTURE_2D, spectrumTextures[0]);
+					glUniform1i(spectrum1Uniform, 2);
+				}
+				if (spectrum2Uniform >= 0) {
+					glActiveTexture(GL_TEXTURE3);
+					glBindTexture(GL_TEXTURE_2D, spectrumTextures[1]);
+					glUniform1i(spectrum2Uniform, 3);
+				}
+				glActiveTexture(GL_TEXTURE0);
+			}
+		}
+		if (pyramid) {
+			uploadPyramid();
+			requestPyramid();
+			GLint uniforms[2] = {pyramid1Uniform, pyramid2Uniform};
+			for (int i = 0; i < 2; i++) {
+				if (uniforms[i] < 0) continue;
+				glActiveTexture(GL_TEXTURE0 + PYRAMID_TEXTURE_UNIT + i);
+				glBindTexture(GL_TEXTURE_2D, pyramidTextures[i]);
+				glUniform1i(uniforms[i], PYRAMID_TEXTURE_UNIT + i);
+			}
+			glActiveTexture(GL_TEXTURE0);
+		}
+		TextureCache::getInstance().update();
+		for (int i = 0; i < MAX_TEXTURES; i++) {
+			if (textureUniforms[i] < 0) continue;
+			glActiveTexture(GL_TEXTURE0 + IMAGE_TEXTURE_UNIT + i);
+			glBindTexture(GL_TEXTURE_2D, textures[i] ? textures[i]->texture : 0);
+			glUniform1i(textureUniforms[i], IMAGE_TEXTURE_UNIT + i);
+		}
+		glActiveTexture(GL_TEXTURE0);
+		if (spectrumSizeUniform >= 0) glUniform1f(spectrumSizeUniform, (float)spectrumTextureBins);
+		if (audioHeadUniform >= 0) glUniform1f(audioHeadUniform, (float)((uploadedHead - 1) % Canvas::HISTORY_SIZE));
+		if (audioHead1Uniform >= 0) glUniform1f(audioHead1Uniform, (float)((getDisplayHead(0) - 1) % Canvas::HISTORY_SIZE));
+		if (audioHead2Uniform >= 0) glUniform1f(audioHead2Uniform, (float)((getDisplayHead(1) - 1) % Canvas::HISTORY_SIZE));
+		if (audioSizeUniform >= 0) glUniform1f(audioSizeUniform, (float)Canvas::HISTORY_SIZE);
+		if (audioLengthUniform >= 0) glUniform1f(audioLengthUniform, (float)module->historyLength);
+		if (channelsUniform >= 0) glUniform2f(channelsUniform, (float)module->ch1, (float)module->ch2);
+		featureUniforms[0].set(module->features[0]);
+		featureUniforms[1].set(module->features[1]);
 		if (trigger1Uniform >= 0) glUniform1f(trigger1Uniform, module->trig1);
 		if (trigger2Uniform >= 0) glUniform1f(trigger2Uniform, module->trig2);
 		if (timeWarp1Uniform >= 0) glUniform1f(timeWarp1Uniform, module->timeWarp1);
@@ -554,10 +1861,31 @@ void GLCanvasWidget::drawFramebuffer() {
 	
 	checkGLError("uniforms");
 	
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+	if (timing) glBeginQuery(GL_TIME_ELAPSED, timerQuery);
+	drawPasses((int)fbSize.x, (int)fbSize.y);
+	if (timing) {
+		glEndQuery(GL_TIME_ELAPSED);
+		timerPending = true;
+	}
+	if (recorder) captureFrame((int)fbSize.x, (int)fbSize.y);
+	collectFrames();
+	readProbes((int)fbSize.x, (int)fbSize.y);
+	collectProbes();
 	
 	if (posAttrib >= 0) glDisableVertexAttribArray(posAttrib);
 	if (texCoordAttrib >= 0) glDisableVertexAttribArray(texCoordAttrib);
+	for (GLenum unit : {GL_TEXTURE0 + PYRAMID_TEXTURE_UNIT + 1, GL_TEXTURE0 + PYRAMID_TEXTURE_UNIT, GL_TEXTURE3, GL_TEXTURE2}) {
+		glActiveTexture(unit);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	for (int i = 0; i < MAX_TEXTURES; i++) {
+		glActiveTexture(GL_TEXTURE0 + IMAGE_TEXTURE_UNIT + i);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, 0);
 	
 	if (!blend_enabled) {
 		glDisable(GL_BLEND);
@@ -568,11 +1896,10 @@ void GLCanvasWidget::drawFramebuffer() {
 }
 
 GLCanvasWidget::~GLCanvasWidget() {
-	if (shaderProgram) glDeleteProgram(shaderProgram);
-	if (VBO) glDeleteBuffers(1, &VBO);
-	if (EBO) glDeleteBuffers(1, &EBO);
-	if (frameBuffer) glDeleteFramebuffers(1, &frameBuffer);
-	if (renderTexture) glDeleteTextures(1, &renderTexture);
+	stopRecording();
+	releaseResources();
+	delete spectrum;
+	delete pyramidUpdate;
 }
 
 struct CanvasWidget : ModuleWidget {
@@ -596,6 +1923,10 @@ struct CanvasWidget : ModuleWidget {
 		addParam(createParamCentered<RoundBlackKnob>(mm2px(Vec(193.773, 81.756)), module, Canvas::PARAM_TIME_2));
 		addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(9.427, 115.864)), module, Canvas::OUTPUT_1));
 		addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(193.773, 115.864)), module, Canvas::OUTPUT_2));
+		addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(9.427, 48.)), module, Canvas::OUTPUT_PROBE_R));
+		addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(9.427, 64.)), module, Canvas::OUTPUT_PROBE_G));
+		addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(193.773, 48.)), module, Canvas::OUTPUT_PROBE_B));
+		addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(193.773, 64.)), module, Canvas::OUTPUT_PROBE_A));
 		
 		// mm2px(Vec(165.49, 128.5))
 		GLCanvasWidget* glCanvas = createWidget<GLCanvasWidget>(mm2px(Vec(18.855, 0.025)));
@@ -608,6 +1939,123 @@ struct CanvasWidget : ModuleWidget {
 			menu->addChild(new MenuSeparator);
 			menu->addChild(createMenuLabel("Shader Source"));
 			addShaderMenuItems(menu, module);
+
+			static const int lengths[] = {256, 1024, 4096, 16384};
+			Canvas* module = this->module;
+			menu->addChild(createIndexSubmenuItem("History length",
+				{"256 samples", "1024 samples", "4096 samples", "16384 samples"},
+				[=]() {
+					for (int i = 3; i > 0; i--) {
+						if (module->historyLength >= lengths[i]) return i;
+					}
+					return 0;
+				},
+				[=](int index) { module->historyLength = lengths[index]; }));
+
+			std::vector<std::string> decimationLabels;
+			for (int i = 0; i <= 6; i++) {
+				decimationLabels.push_back(i == 0 ? "Off" : string::f("1/%d", 1 << i));
+			}
+			menu->addChild(createIndexSubmenuItem("Decimation", decimationLabels,
+				[=]() {
+					int index = 0;
+					while (index < 6 && (1 << (index + 1)) <= module->decimation) index++;
+					return index;
+				},
+				[=](int index) { module->decimation = 1 << index; }));
+
+			static const float smoothings[] = {0.f, 0.3f, 0.6f, 0.9f};
+			menu->addChild(createIndexSubmenuItem("Smoothing",
+				{"Off", "Light", "Medium", "Heavy"},
+				[=]() {
+					for (int i = 3; i > 0; i--) {
+						if (module->smoothingFactor >= smoothings[i]) return i;
+					}
+					return 0;
+				},
+				[=](int index) { module->smoothingFactor = smoothings[index]; }));
+
+			menu->addChild(createBoolPtrMenuItem("Trigger sync", "", &module->triggerSync));
+
+			static const float scales[] = {0.f, 1.f, 0.75f, 0.5f, 0.25f};
+			menu->addChild(createIndexSubmenuItem("Render scale",
+				{"Auto", "100%", "75%", "50%", "25%"},
+				[=]() {
+					for (int i = 0; i < 5; i++) {
+						if (module->renderScale == scales[i]) return i;
+					}
+					return 1;
+				},
+				[=](int index) { module->renderScale = scales[index]; }));
+			if (module->renderScale == 0.f && module->glCanvas) {
+				menu->addChild(createMenuLabel(string::f("Rendering at %d%%", (int)std::round(module->glCanvas->autoScale * 100.f))));
+			}
+
+			static const int fpsLimits[] = {0, 60, 30, 15};
+			menu->addChild(createIndexSubmenuItem("Max FPS",
+				{"Unlimited", "60", "30", "15"},
+				[=]() {
+					for (int i = 3; i > 0; i--) {
+						if (module->maxFps > 0 && module->maxFps <= fpsLimits[i]) return i;
+					}
+					return 0;
+				},
+				[=](int index) { module->maxFps = fpsLimits[index]; }));
+			if (module->glCanvas) {
+				menu->addChild(createMenuLabel("GPU memory: " + gl::formatBytes(module->glCanvas->getGpuMemory())));
+			}
+
+			menu->addChild(new MenuSeparator);
+			menu->addChild(createMenuLabel("Recording"));
+			GLCanvasWidget* glCanvas = module->glCanvas;
+			if (glCanvas && glCanvas->recorder) {
+				std::shared_ptr<FrameRecorder> recorder = glCanvas->recorder;
+				menu->addChild(createMenuLabel(string::f("%d frames written, %d dropped",
+					recorder->getWrittenFrames(), recorder->getDroppedFrames())));
+				menu->addChild(createMenuItem("Stop recording", "", [=]() {
+					glCanvas->stopRecording();
+				}));
+			}
+			else if (glCanvas) {
+				menu->addChild(createMenuItem("Start recording...", "", [=]() {
+					char* path = osdialog_file(OSDIALOG_SAVE, NULL, "canvas", NULL);
+					if (!path) return;
+					std::string base = path;
+					std::free(path);
+					for (const char* extension : {".y4m", ".ppm", ".rgba"}) {
+						size_t length = std::strlen(extension);
+						if (base.size() > length && base.compare(base.size() - length, length, extension) == 0) {
+							base.resize(base.size() - length);
+						}
+					}
+					glCanvas->startRecording(base);
+				}));
+			}
+			menu->addChild(createIndexPtrSubmenuItem("Record format",
+				{"Y4M video", "PPM sequence", "Raw RGBA"}, &module->recordFormat));
+			menu->addChild(new MenuSeparator);
+
+			menu->addChild(createIndexSubmenuItem("Spectrum size",
+				{"1024", "2048", "4096", "8192"},
+				[=]() {
+					int index = 0;
+					while (index < 3 && (Spectrum::MIN_SIZE << (index + 1)) <= module->spectrumSize) index++;
+					return index;
+				},
+				[=](int index) { module->spectrumSize = Spectrum::MIN_SIZE << index; }));
+			menu->addChild(createIndexPtrSubmenuItem("Spectrum response",
+				{"Raw", "Smooth", "Peak hold"}, &module->spectrumResponse));
+
+			static const float probeSmoothings[] = {0.f, 0.02f, 0.1f, 0.5f};
+			menu->addChild(createIndexSubmenuItem("Probe smoothing",
+				{"Off", "20 ms", "100 ms", "500 ms"},
+				[=]() {
+					for (int i = 3; i > 0; i--) {
+						if (module->probeSmoothing >= probeSmoothings[i]) return i;
+					}
+					return 0;
+				},
+				[=](int index) { module->probeSmoothing = probeSmoothings[index]; }));
 		}
 	}
 };
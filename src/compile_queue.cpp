@@ -0,0 +1,143 @@
+#include "compile_queue.hpp"
+#include "program_binary_cache.hpp"
+
+CompileQueue::Context& CompileQueue::getContext() {
+    GLFWwindow* window = glfwGetCurrentContext();
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = contexts.find(window);
+    if (it != contexts.end()) return it->second;
+
+    Context& context = contexts[window];
+    context.parallel = GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+    if (GLEW_KHR_parallel_shader_compile) {
+        // as many threads as the driver likes
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    }
+    //INFO("CompileQueue: Parallel shader compile %s", context.parallel ? "available" : "unavailable");
+    return context;
+}
+
+CompileQueue::Handle CompileQueue::push(GLuint program, const std::string& vertexSource, const std::string& fragmentSource) {
+    Handle job = std::make_shared<Job>();
+    job->program = program;
+    job->sources[0] = vertexSource;
+    job->sources[1] = fragmentSource;
+    getContext().queued.push_back(job);
+    return job;
+}
+
+void CompileQueue::update() {
+    Context& context = getContext();
+    double begin = system::getTime();
+    if (begin - context.frameStart >= FRAME_SECONDS) {
+        context.frameStart = begin;
+        context.spent = 0.0;
+    }
+
+    for (size_t i = 0; i < context.compiling.size();) {
+        Job& job = *context.compiling[i];
+        bool orphaned = context.compiling[i].use_count() == 1;
+        if (!orphaned && !isComplete(job)) {
+            i++;
+            continue;
+        }
+        // an orphaned job's program is gone with its last subscriber
+        if (orphaned) deleteShaders(job, false);
+        else finish(job);
+        context.compiling.erase(context.compiling.begin() + i);
+    }
+
+    while (!context.queued.empty()
+        && (int)context.compiling.size() < MAX_COMPILING
+        && context.spent + system::getTime() - begin < BUDGET_SECONDS) {
+        Handle job = context.queued.front();
+        context.queued.pop_front();
+        if (job.use_count() == 1) continue;
+        start(context, job);
+    }
+    context.spent += system::getTime() - begin;
+}
+
+void CompileQueue::start(Context& context, const Handle& job) {
+    if (job->program && ProgramBinaryCache::getInstance().load(job->program, job->sources[0], job->sources[1])) {
+        job->state = Job::DONE;
+        return;
+    }
+
+    const GLenum types[2] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER};
+    for (int i = 0; i < 2; i++) {
+        if (job->sources[i].empty()) continue;
+        job->shaders[i] = glCreateShader(types[i]);
+        const char* source = job->sources[i].c_str();
+        glShaderSource(job->shaders[i], 1, &source, nullptr);
+        glCompileShader(job->shaders[i]);
+        if (job->program) glAttachShader(job->program, job->shaders[i]);
+    }
+    // e.g. GLAB's editor cleared; the driver would reject it the same way
+    if (!job->shaders[0] && !job->shaders[1]) {
+        job->state = Job::FAILED;
+        return;
+    }
+    if (job->program) {
+        ProgramBinaryCache::getInstance().prepare(job->program);
+        glLinkProgram(job->program);
+    }
+    job->state = Job::COMPILING;
+
+    // without the extension, the status queries in finish() wait for the driver
+    if (context.parallel) context.compiling.push_back(job);
+    else finish(*job);
+}
+
+bool CompileQueue::isComplete(const Job& job) {
+    GLint complete = GL_TRUE;
+    if (job.program) {
+        glGetProgramiv(job.program, GL_COMPLETION_STATUS_KHR, &complete);
+        return complete;
+    }
+    for (GLuint shader : job.shaders) {
+        if (!shader) continue;
+        glGetShaderiv(shader, GL_COMPLETION_STATUS_KHR, &complete);
+        if (!complete) return false;
+    }
+    return true;
+}
+
+void CompileQueue::finish(Job& job) {
+    bool ok = true;
+    for (GLuint shader : job.shaders) {
+        if (!shader) continue;
+        GLint compiled;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+        if (!compiled) {
+            GLchar infoLog[512];
+            glGetShaderInfoLog(shader, 512, nullptr, infoLog);
+            WARN("Shader compilation failed: %s", infoLog);
+            ok = false;
+        }
+    }
+    if (ok && job.program) {
+        GLint linked;
+        glGetProgramiv(job.program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            GLchar infoLog[512];
+            glGetProgramInfoLog(job.program, 512, nullptr, infoLog);
+            WARN("Shader program linking failed: %s", infoLog);
+            ok = false;
+        }
+    }
+    deleteShaders(job, true);
+    if (ok && job.program) {
+        ProgramBinaryCache::getInstance().store(job.program, job.sources[0], job.sources[1]);
+    }
+    job.state = ok ? Job::DONE : Job::FAILED;
+}
+
+void CompileQueue::deleteShaders(Job& job, bool detach) {
+    for (GLuint& shader : job.shaders) {
+        if (!shader) continue;
+        if (detach && job.program) glDetachShader(job.program, shader);
+        glDeleteShader(shader);
+        shader = 0;
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "plugin.hpp"
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// shader compiles for every module, spread over frames so a patch full of
+// shaders doesn't freeze on its first frame. each GL context has its own queue:
+// push() and update() are called on the thread the context is current on, and
+// update() once per frame (or scheduler tick) starts queued jobs until
+// BUDGET_SECONDS of the frame are spent, at least one per frame. with
+// GL_KHR_parallel_shader_compile the driver compiles on its own threads and
+// update() only polls for completion; otherwise each job compiles in place and
+// the budget bounds the stall. jobs nobody holds anymore are dropped
+class CompileQueue {
+public:
+    static constexpr double BUDGET_SECONDS = 0.004;
+    // update() calls closer together than this share one budget
+    static constexpr double FRAME_SECONDS = 1.0 / 60.0;
+    // jobs handed to the driver's threads at once
+    static const int MAX_COMPILING = 8;
+
+    struct Job {
+        enum State {
+            QUEUED,
+            COMPILING,
+            DONE,
+            FAILED
+        };
+        State state = QUEUED;
+        // linked into when set; 0 only checks that the sources compile
+        GLuint program = 0;
+        // vertex and fragment; an empty source is skipped
+        std::string sources[2];
+        GLuint shaders[2] = {0, 0};
+
+        bool isFinished() const { return state == DONE || state == FAILED; }
+    };
+    typedef std::shared_ptr<Job> Handle;
+
+    static CompileQueue& getInstance() {
+        static CompileQueue instance;
+        return instance;
+    }
+
+    Handle push(GLuint program, const std::string& vertexSource, const std::string& fragmentSource);
+    void update();
+
+private:
+    struct Context {
+        std::deque<Handle> queued;
+        std::vector<Handle> compiling;
+        double frameStart = 0.0;
+        double spent = 0.0;
+        bool parallel = false;
+    };
+
+    CompileQueue() {}
+    CompileQueue(const CompileQueue&) = delete;
+    CompileQueue& operator=(const CompileQueue&) = delete;
+
+    Context& getContext();
+    void start(Context& context, const Handle& job);
+    bool isComplete(const Job& job);
+    void finish(Job& job);
+    void deleteShaders(Job& job, bool detach);
+
+    // entries are never erased, so references stay valid while other threads add theirs
+    std::map<GLFWwindow*, Context> contexts;
+    std::mutex mutex;
+};
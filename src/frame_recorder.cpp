@@ -0,0 +1,143 @@
+#include "frame_recorder.hpp"
+
+std::shared_ptr<FrameRecorder> FrameRecorder::start(const std::string& path, Format format, int fps) {
+    std::shared_ptr<FrameRecorder> recorder(new FrameRecorder);
+    recorder->path = path;
+    recorder->format = format;
+    recorder->fps = std::max(fps, 1);
+    recorder->recording = true;
+    // the thread's copy of the shared_ptr keeps the recorder alive until the queue has drained
+    std::thread(&FrameRecorder::run, recorder).detach();
+    return recorder;
+}
+
+void FrameRecorder::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+}
+
+bool FrameRecorder::push(Frame&& frame) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping || (int)queue.size() >= MAX_QUEUED_FRAMES) {
+            droppedFrames++;
+            freeFrames.push_back(std::move(frame));
+            return false;
+        }
+        queue.push_back(std::move(frame));
+    }
+    wake.notify_one();
+    return true;
+}
+
+FrameRecorder::Frame FrameRecorder::takeFreeFrame() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (freeFrames.empty()) return Frame();
+    Frame frame = std::move(freeFrames.back());
+    freeFrames.pop_back();
+    return frame;
+}
+
+void FrameRecorder::run() {
+    system::setThreadName("0x502 recorder");
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        if (queue.empty()) {
+            if (stopping) break;
+            wake.wait(lock);
+            continue;
+        }
+        Frame frame = std::move(queue.front());
+        queue.pop_front();
+        lock.unlock();
+        if (writeFrame(frame)) {
+            writtenFrames++;
+        } else {
+            droppedFrames++;
+        }
+        lock.lock();
+        freeFrames.push_back(std::move(frame));
+    }
+    lock.unlock();
+
+    if (file) fclose(file);
+    file = nullptr;
+    recording = false;
+    INFO("FrameRecorder: Wrote %d frames to %s, dropped %d", (int)writtenFrames, path.c_str(), (int)droppedFrames);
+}
+
+// the first frame fixes the size; Y4M and raw streams can't change it halfway
+bool FrameRecorder::writeFrame(const Frame& frame) {
+    if (!width) {
+        width = frame.width;
+        height = frame.height;
+    }
+    if (frame.width != width || frame.height != height) return false;
+
+    if (format == FORMAT_PPM) {
+        std::string framePath = string::f("%s_%06d.ppm", path.c_str(), (int)writtenFrames);
+        file = fopen(framePath.c_str(), "wb");
+        if (!file) {
+            WARN("FrameRecorder: Could not open %s", framePath.c_str());
+            return false;
+        }
+        fprintf(file, "P6\n%d %d\n255\n", width, height);
+        row.resize((size_t)width * 3);
+        for (int y = height - 1; y >= 0; y--) {
+            const uint8_t* pixels = &frame.pixels[(size_t)y * width * 4];
+            for (int x = 0; x < width; x++) {
+                row[x * 3 + 0] = pixels[x * 4 + 0];
+                row[x * 3 + 1] = pixels[x * 4 + 1];
+                row[x * 3 + 2] = pixels[x * 4 + 2];
+            }
+            fwrite(row.data(), 1, row.size(), file);
+        }
+        fclose(file);
+        file = nullptr;
+        return true;
+    }
+
+    if (!file) {
+        const char* extension = format == FORMAT_Y4M ? "y4m" : "rgba";
+        std::string filePath = string::f("%s_%dx%d.%s", path.c_str(), width, height, extension);
+        file = fopen(filePath.c_str(), "wb");
+        if (!file) {
+            WARN("FrameRecorder: Could not open %s", filePath.c_str());
+            return false;
+        }
+        if (format == FORMAT_Y4M) {
+            fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444 XCOLORRANGE=FULL\n", width, height, fps);
+        }
+    }
+
+    if (format == FORMAT_RGBA) {
+        for (int y = height - 1; y >= 0; y--) {
+            fwrite(&frame.pixels[(size_t)y * width * 4], 1, (size_t)width * 4, file);
+        }
+        return true;
+    }
+
+    // full-range BT.601, one plane at a time
+    fputs("FRAME\n", file);
+    row.resize(width);
+    for (int plane = 0; plane < 3; plane++) {
+        for (int y = height - 1; y >= 0; y--) {
+            const uint8_t* pixels = &frame.pixels[(size_t)y * width * 4];
+            for (int x = 0; x < width; x++) {
+                float r = pixels[x * 4 + 0];
+                float g = pixels[x * 4 + 1];
+                float b = pixels[x * 4 + 2];
+                float value;
+                if (plane == 0) value = 0.299f * r + 0.587f * g + 0.114f * b;
+                else if (plane == 1) value = 128.f - 0.168736f * r - 0.331264f * g + 0.5f * b;
+                else value = 128.f + 0.5f * r - 0.418688f * g - 0.081312f * b;
+                row[x] = (uint8_t)clamp(value + 0.5f, 0.f, 255.f);
+            }
+            fwrite(row.data(), 1, row.size(), file);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "plugin.hpp"
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// streams frames to disk on its own thread. push() never blocks: when more
+// than MAX_QUEUED_FRAMES are waiting for the disk, the frame is dropped and
+// counted instead. the writer thread holds a reference to the recorder, so
+// stop() returns immediately and the queue drains in the background
+class FrameRecorder {
+public:
+    enum Format {
+        FORMAT_Y4M,
+        FORMAT_PPM,
+        FORMAT_RGBA,
+        FORMATS_LEN
+    };
+
+    // bottom-up RGBA8, straight from glReadPixels
+    struct Frame {
+        int width = 0;
+        int height = 0;
+        std::vector<uint8_t> pixels;
+    };
+
+    static const int MAX_QUEUED_FRAMES = 8;
+
+    // `path` is the file name without extension. Y4M and raw RGBA write one
+    // file, PPM one file per frame (path_000000.ppm, ...)
+    static std::shared_ptr<FrameRecorder> start(const std::string& path, Format format, int fps);
+    void stop();
+    // false if the frame was dropped
+    bool push(Frame&& frame);
+    // counts a frame the caller had to drop before it got here
+    void dropFrame() { droppedFrames++; }
+
+    bool isRecording() const { return recording; }
+    int getWrittenFrames() const { return writtenFrames; }
+    int getDroppedFrames() const { return droppedFrames; }
+    const std::string& getPath() const { return path; }
+
+    // frames are recycled to avoid reallocating a canvas-sized buffer per frame
+    Frame takeFreeFrame();
+
+private:
+    FrameRecorder() {}
+    void run();
+    bool writeFrame(const Frame& frame);
+
+    std::string path;
+    Format format = FORMAT_Y4M;
+    int fps = 60;
+    FILE* file = nullptr;
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> row;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Frame> queue;
+    std::vector<Frame> freeFrames;
+    bool stopping = false;
+    std::atomic<bool> recording{false};
+    std::atomic<int> writtenFrames{0};
+    std::atomic<int> droppedFrames{0};
+};
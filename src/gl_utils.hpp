@@ -2,6 +2,7 @@
 #include <string>
 #include <fstream>
 #include <sstream>
+#include <vector>
 
 namespace gl {
 
@@ -40,4 +41,141 @@ inline GLuint compileShader(const std::string& source, GLenum type) {
     return shader;
 }
 
+// `#pragma <scope> <directive> [args...]` lines let a GLIB shader pair declare
+// extra resources (passes, state textures, ...) to the module running it.
+// unknown pragmas are ignored by the GLSL compiler, so the same source stays valid
+struct Pragma {
+    std::string directive;
+    std::vector<std::string> args;
+};
+
+inline std::vector<Pragma> parsePragmas(const std::string& source, const std::string& scope) {
+    std::vector<Pragma> pragmas;
+    std::istringstream lines(source);
+    std::string line;
+    while (std::getline(lines, line)) {
+        std::istringstream tokens(line);
+        std::string hash, keyword, lineScope;
+        tokens >> hash;
+        if (hash == "#") {
+            tokens >> keyword;
+        } else if (hash.compare(0, 1, "#") == 0) {
+            keyword = hash.substr(1);
+        }
+        if (keyword != "pragma") continue;
+        tokens >> lineScope;
+        if (lineScope != scope) continue;
+
+        Pragma pragma;
+        if (!(tokens >> pragma.directive)) continue;
+        std::string arg;
+        while (tokens >> arg) {
+            if (arg.compare(0, 2, "//") == 0) break;
+            pragma.args.push_back(arg);
+        }
+        pragmas.push_back(pragma);
+    }
+    return pragmas;
+}
+
+// for GPU memory shown in context menus
+inline std::string formatBytes(size_t bytes) {
+    if (bytes < 1024 * 1024) return string::f("%d KB", (int)((bytes + 1023) / 1024));
+    return string::f("%.1f MB", bytes / (1024.f * 1024.f));
+}
+
+// asynchronous RGBA8 glReadPixels into a small ring of pixel buffers. read()
+// copies a rectangle of the bound read framebuffer into the next free buffer
+// and fences it; collect() maps the finished ones, oldest first, and never
+// waits on the GPU. while every buffer is still in flight read() returns false
+// and the caller drops that frame. needs GL 3.2 or ARB_sync
+struct ReadbackRing {
+    struct Buffer {
+        GLuint pbo = 0;
+        GLsync fence = nullptr;
+        size_t capacity = 0;
+        int x = 0;
+        int y = 0;
+        int width = 0;
+        int height = 0;
+        // size of the framebuffer the rectangle was read from
+        int frameWidth = 0;
+        int frameHeight = 0;
+    };
+    static const int SIZE = 3;
+    Buffer buffers[SIZE];
+    // the oldest buffer in flight, or the next one to use
+    int oldest = 0;
+
+    static bool isSupported() {
+        return GLEW_VERSION_3_2 || GLEW_ARB_sync;
+    }
+
+    bool read(int x, int y, int width, int height, int frameWidth, int frameHeight) {
+        if (!isSupported()) return false;
+        Buffer* buffer = nullptr;
+        for (int i = 0; i < SIZE && !buffer; i++) {
+            Buffer& candidate = buffers[(oldest + i) % SIZE];
+            if (!candidate.fence) buffer = &candidate;
+        }
+        if (!buffer) return false;
+
+        size_t size = (size_t)width * height * 4;
+        if (!buffer->pbo) glGenBuffers(1, &buffer->pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer->pbo);
+        if (size > buffer->capacity) {
+            glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+            buffer->capacity = size;
+        }
+        glReadPixels(x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        buffer->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        buffer->x = x;
+        buffer->y = y;
+        buffer->width = width;
+        buffer->height = height;
+        buffer->frameWidth = frameWidth;
+        buffer->frameHeight = frameHeight;
+        return true;
+    }
+
+    // calls f(const Buffer&, const uint8_t* pixels) for every finished readback,
+    // pixels bottom-up and tightly packed. pixels is null if mapping failed
+    template <typename F>
+    void collect(F f) {
+        for (int i = 0; i < SIZE; i++) {
+            Buffer& buffer = buffers[oldest];
+            if (!buffer.fence) break;
+            GLenum status = glClientWaitSync(buffer.fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+            glDeleteSync(buffer.fence);
+            buffer.fence = nullptr;
+            oldest = (oldest + 1) % SIZE;
+
+            size_t size = (size_t)buffer.width * buffer.height * 4;
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.pbo);
+            const uint8_t* pixels = (const uint8_t*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+            f(buffer, pixels);
+            if (pixels) glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+    }
+
+    size_t getMemory() const {
+        size_t bytes = 0;
+        for (const Buffer& buffer : buffers) bytes += buffer.capacity;
+        return bytes;
+    }
+
+    // the GL context must be current
+    void release() {
+        for (Buffer& buffer : buffers) {
+            if (buffer.fence) glDeleteSync(buffer.fence);
+            if (buffer.pbo) glDeleteBuffers(1, &buffer.pbo);
+            buffer = Buffer();
+        }
+        oldest = 0;
+    }
+};
+
 } // namespace gl 
@@ -317,37 +317,37 @@ std::vector<std::string> GlabTextField::wrapText(const std::string& text, float
 
 void GlabVertexField::step() {
 	LedDisplayTextField::step();
-	if (module && module->requestVertexCompile) {
-		if (getText() != module->vertexShaderText) {
-			setText(module->vertexShaderText);
-		}
-		module->requestVertexCompile = false;
+	// the module's text was replaced (preset, subscription, ...). GlabWidget
+	// clears the request after its children have stepped
+	if (module && module->requestVertexCompile && getText() != module->vertexShaderText) {
+		setText(module->vertexShaderText);
 	}
 }
 
 void GlabVertexField::onChange(const ChangeEvent& e) {
-	if (module) {
+	// setText() with the module's own text lands here too
+	if (module && getText() != module->vertexShaderText) {
 		module->vertexShaderText = getText();
 		module->isDirty = true;
-		module->requestVertexCompile = true;
+		module->vertexEditTime = system::getTime();
 	}
 }
 
 void GlabFragmentField::step() {
 	LedDisplayTextField::step();
-	if (module && module->requestFragmentCompile) {
-		if (getText() != module->fragmentShaderText) {
-			setText(module->fragmentShaderText);
-		}
-		module->requestFragmentCompile = false;
+	// the module's text was replaced (preset, subscription, ...). GlabWidget
+	// clears the request after its children have stepped
+	if (module && module->requestFragmentCompile && getText() != module->fragmentShaderText) {
+		setText(module->fragmentShaderText);
 	}
 }
 
 void GlabFragmentField::onChange(const ChangeEvent& e) {
-	if (module) {
+	// setText() with the module's own text lands here too
+	if (module && getText() != module->fragmentShaderText) {
 		module->fragmentShaderText = getText();
 		module->isDirty = true;
-		module->requestFragmentCompile = true;
+		module->fragmentEditTime = system::getTime();
 	}
 }
 
@@ -594,20 +594,41 @@ void GlabWidget::step() {
 	Glab* module = dynamic_cast<Glab*>(this->module);
 	if (!module) return;
 
-	if (module->requestVertexCompile) {
-		GLuint shader = gl::compileShader(module->vertexShaderText, GL_VERTEX_SHADER);
-		module->vertexShaderValid = shader != 0;
-		if (shader) glDeleteShader(shader);
+	// typing compiles once it pauses, not on every keystroke
+	double now = system::getTime();
+	if (module->vertexEditTime >= 0.0 && now - module->vertexEditTime >= EDIT_COMPILE_SECONDS) {
+		module->vertexEditTime = -1.0;
+		module->requestVertexCompile = true;
+	}
+	if (module->fragmentEditTime >= 0.0 && now - module->fragmentEditTime >= EDIT_COMPILE_SECONDS) {
+		module->fragmentEditTime = -1.0;
+		module->requestFragmentCompile = true;
+	}
+
+	// one compile per stage in flight; a request arriving meanwhile waits for it
+	CompileQueue& compileQueue = CompileQueue::getInstance();
+	if (module->requestVertexCompile && !vertexCompile) {
+		module->requestVertexCompile = false;
+		vertexCompile = compileQueue.push(0, module->vertexShaderText, "");
+	}
+	if (module->requestFragmentCompile && !fragmentCompile) {
+		module->requestFragmentCompile = false;
+		fragmentCompile = compileQueue.push(0, "", module->fragmentShaderText);
+	}
+	compileQueue.update();
+
+	if (vertexCompile && vertexCompile->isFinished()) {
+		module->vertexShaderValid = vertexCompile->state == CompileQueue::Job::DONE;
 		module->lights[Glab::LIGHT_COMP_V].setBrightness(module->vertexShaderValid ? 1.f : 0.f);
 		module->isDirty = true;
+		vertexCompile = nullptr;
 	}
 	
-	if (module->requestFragmentCompile) {
-		GLuint shader = gl::compileShader(module->fragmentShaderText, GL_FRAGMENT_SHADER);
-		module->fragmentShaderValid = shader != 0;
-		if (shader) glDeleteShader(shader);
+	if (fragmentCompile && fragmentCompile->isFinished()) {
+		module->fragmentShaderValid = fragmentCompile->state == CompileQueue::Job::DONE;
 		module->lights[Glab::LIGHT_COMP_F].setBrightness(module->fragmentShaderValid ? 1.f : 0.f);
 		module->isDirty = true;
+		fragmentCompile = nullptr;
 	}
 }
 
@@ -2,6 +2,7 @@
 #include "plugin.hpp"
 #include "shader_manager.hpp"
 #include "gl_utils.hpp"
+#include "compile_queue.hpp"
 #include "glib.hpp"
 #include "shader_menu.hpp"
 
@@ -107,6 +108,9 @@ struct Glab : Module, ShaderSubscriber {
 	
 	bool requestVertexCompile = false;
 	bool requestFragmentCompile = false;
+	// when the editors last changed the text, -1 once compiled
+	double vertexEditTime = -1.0;
+	double fragmentEditTime = -1.0;
 	
 	bool wasPublishPressed = false;
 
@@ -121,6 +125,12 @@ struct Glab : Module, ShaderSubscriber {
 };
 
 struct GlabWidget : ModuleWidget {
+	// typing compiles after this long without a keystroke
+	static constexpr double EDIT_COMPILE_SECONDS = 0.5;
+
+	CompileQueue::Handle vertexCompile;
+	CompileQueue::Handle fragmentCompile;
+
 	void step() override;
 	void appendContextMenu(Menu* menu) override;
 	GlabWidget(Glab* module);
@@ -1,9 +1,8 @@
 #include "glaze.hpp"
 #include "gl_utils.hpp"
+#include "shader_rewrite.hpp"
 
 GLProcessor::GLProcessor() {
-	box.size = math::Vec(1, 1);
-	visible = true;
 }
 
 void GLProcessor::setModule(Glaze* mod) {
@@ -16,72 +15,54 @@ void GLProcessor::setModule(Glaze* mod) {
 }
 
 void GLProcessor::createShaderProgram() {
-	if (!initialized || !module) {
-		WARN("GLProcessor: Not initialized or no module");
+	if (!module) {
+		WARN("GLProcessor: No module");
 		dirty = false;
 		return;
 	}
 
 	//INFO("GLProcessor: Creating shader program for module %lld", (long long)module->id);
 
-	if (shaderProgram) {
-		glDeleteProgram(shaderProgram);
-		shaderProgram = 0;
-	}
-
 	auto& shaderLib = SharedShaderLibrary::getInstance();
-	const ShaderSubscription* sub = shaderLib.getSubscription(module->id);
-	if (!sub || !sub->isValid) {
+	ShaderSubscription sub;
+	if (!shaderLib.copySubscription(module->id, sub) || !sub.isValid) {
 		WARN("GLProcessor: No valid shader subscription for module %lld", (long long)module->id);
 		dirty = false;
 		return;
 	}
-	//INFO("GLProcessor: Found subscription - Glib: %lld, Shader: %d", (long long)sub->glibId, sub->shaderIndex);
+	//INFO("GLProcessor: Found subscription - Glib: %lld, Shader: %d", (long long)sub.glibId, sub.shaderIndex);
 
-	const ShaderPair* shaderPair = shaderLib.getShaderForModule(module->id);
-	if (!shaderPair || !shaderPair->isValid) {
+	ShaderPair shader;
+	const ShaderPair* shaderPair = &shader;
+	if (!shaderLib.copyShaderForModule(module->id, shader) || !shader.isValid) {
 		WARN("GLProcessor: No valid shader pair found for module %lld", (long long)module->id);
 		dirty = false;
 		return;
 	}
 	//INFO("GLProcessor: Found shader pair: %s", shaderPair->name.c_str());
 
-	GLuint vertShader = gl::compileShader(shaderPair->vertexSource.c_str(), GL_VERTEX_SHADER);
-	if (!vertShader) {
-		INFO("Failed to compile vertex shader");
-		dirty = false;
-		return;
-	}
-
-	GLuint fragShader = gl::compileShader(shaderPair->fragmentSource.c_str(), GL_FRAGMENT_SHADER);
-	if (!fragShader) {
-		INFO("Failed to compile fragment shader");
-		glDeleteShader(vertShader);
-		dirty = false;
-		return;
-	}
-
-	shaderProgram = glCreateProgram();
-	glAttachShader(shaderProgram, vertShader);
-	glAttachShader(shaderProgram, fragShader);
-	glLinkProgram(shaderProgram);
+	// replaces a request that is still compiling
+	shaderLib.releaseProgram(pendingProgram);
+	pendingShader = *shaderPair;
+	pendingProgram = shaderLib.acquireProgram(pendingShader.vertexSource, pendingShader.fragmentSource);
+	dirty = false;
+}
 
-	GLint ok;
-	glGetProgramiv(shaderProgram, GL_LINK_STATUS, &ok);
-	if (!ok) {
-		GLchar infoLog[512];
-		glGetProgramInfoLog(shaderProgram, sizeof(infoLog), NULL, infoLog);
-		INFO("Shader program linking failed: %s", infoLog);
-		glDeleteProgram(shaderProgram);
-		glDeleteShader(vertShader);
-		glDeleteShader(fragShader);
-		shaderProgram = 0;
-		dirty = false;
+void GLProcessor::installShaderProgram() {
+	auto& shaderLib = SharedShaderLibrary::getInstance();
+	SharedShaderLibrary::ProgramStatus status = shaderLib.getProgramStatus(pendingProgram);
+	if (status == SharedShaderLibrary::PROGRAM_PENDING) return;
+	if (status == SharedShaderLibrary::PROGRAM_FAILED) {
+		shaderLib.releaseProgram(pendingProgram);
+		pendingProgram = 0;
 		return;
 	}
-
-	glDeleteShader(vertShader);
-	glDeleteShader(fragShader);
+	shaderLib.releaseProgram(shaderProgram);
+	deleteBlockBackend();
+	activeBackend = Glaze::GPU_BACKEND_FRAGMENT;
+	shaderProgram = pendingProgram;
+	pendingProgram = 0;
+	const ShaderPair* shaderPair = &pendingShader;
 
 	glUseProgram(shaderProgram);
 	posAttrib = glGetAttribLocation(shaderProgram, "vs_Pos");
@@ -91,13 +72,38 @@ void GLProcessor::createShaderProgram() {
 	u2Uniform = glGetUniformLocation(shaderProgram, "u2");
 	u3Uniform = glGetUniformLocation(shaderProgram, "u3");
 	modeUniform = glGetUniformLocation(shaderProgram, "mode");
+	passUniform = glGetUniformLocation(shaderProgram, "u_Pass");
+	passCountUniform = glGetUniformLocation(shaderProgram, "u_PassCount");
+	passSizeUniform = glGetUniformLocation(shaderProgram, "u_PassSize");
+	frameUniform = glGetUniformLocation(shaderProgram, "u_Frame");
+	featureUniforms[0].locate(shaderProgram, 1);
+	featureUniforms[1].locate(shaderProgram, 2);
 
 	setupFramebuffer();
 	setupGeometry();
+	setupStateTextures(shaderPair->fragmentSource);
+
+	// the fragment program above stays around as the fallback; state textures
+	// only exist in the fragment path, so such shaders never run per sample
+	int backend = Glaze::GPU_BACKEND_FRAGMENT;
+	if (stateTextures.empty()) {
+		int preferred = module->gpuBackend;
+		if ((preferred == Glaze::GPU_BACKEND_AUTO || preferred == Glaze::GPU_BACKEND_COMPUTE)
+			&& createBlockBackend(shaderPair->fragmentSource, Glaze::GPU_BACKEND_COMPUTE)) {
+			backend = Glaze::GPU_BACKEND_COMPUTE;
+		} else if (preferred != Glaze::GPU_BACKEND_FRAGMENT
+			&& createBlockBackend(shaderPair->fragmentSource, Glaze::GPU_BACKEND_FEEDBACK)) {
+			backend = Glaze::GPU_BACKEND_FEEDBACK;
+		}
+	}
+	while (!inputFrames.empty()) inputFrames.shift();
+	blockBuffering = true;
+	activeBackend = backend;
+	updateGpuMemory();
+	//INFO("GLProcessor: Using backend %d", backend);
 
-    gl::checkError("createShaderProgram");
+    gl::checkError("installShaderProgram");
 	//INFO("Shader program created successfully");
-	dirty = false;
 }
 
 void GLProcessor::setupFramebuffer() {
@@ -115,6 +121,18 @@ void GLProcessor::setupFramebuffer() {
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, renderTexture, 0);
 }
 
+void GLProcessor::updateGpuMemory() {
+	size_t bytes = 0;
+	if (renderTexture) bytes += 2 * 16;
+	if (VBO) bytes += 12 * 4;
+	if (EBO) bytes += 6 * 4;
+	for (const StateTexture& state : stateTextures) {
+		bytes += (size_t)2 * state.size * 16;
+	}
+	if (blockProgram) bytes += blockInput.size() * 4 + blockOutput.size() * 4;
+	gpuMemory = bytes;
+}
+
 void GLProcessor::setupGeometry() {
 	float vertices[] = {
 		-1.0f,  1.0f, 0.0f,
@@ -127,36 +145,335 @@ void GLProcessor::setupGeometry() {
 		1, 3, 2
 	};
 	
-	glGenBuffers(1, &VBO);
+	// every recompile comes through here, so the buffers are only created once
+	if (!VBO) glGenBuffers(1, &VBO);
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 	
-	glGenBuffers(1, &EBO);
+	if (!EBO) glGenBuffers(1, &EBO);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 }
 
-void GLProcessor::step() {
-	if (!initialized) {
-		OpenGlWidget::step();
-		initialized = true;
-		return;
+void GLProcessor::setupStateTextures(const std::string& fragmentSource) {
+	deleteStateTextures();
+	frameCount = 0;
+
+	for (const gl::Pragma& pragma : gl::parsePragmas(fragmentSource, "glaze")) {
+		if (pragma.directive != "state") continue;
+		if (pragma.args.empty()) {
+			WARN("GLProcessor: '#pragma glaze state' needs a sampler name");
+			continue;
+		}
+		if ((int)stateTextures.size() >= MAX_STATE_TEXTURES) {
+			WARN("GLProcessor: Ignoring state '%s', at most %d state textures are supported", pragma.args[0].c_str(), MAX_STATE_TEXTURES);
+			continue;
+		}
+
+		StateTexture state;
+		state.name = pragma.args[0];
+		if (pragma.args.size() > 1) {
+			state.size = clamp(std::atoi(pragma.args[1].c_str()), 1, MAX_STATE_SIZE);
+		}
+		state.samplerUniform = glGetUniformLocation(shaderProgram, state.name.c_str());
+
+		// start from silence: a NULL upload would leave the delay memory undefined
+		std::vector<float> zeros(state.size * 4, 0.f);
+		glGenTextures(2, state.textures);
+		glGenFramebuffers(2, state.frameBuffers);
+		for (int i = 0; i < 2; i++) {
+			glBindTexture(GL_TEXTURE_2D, state.textures[i]);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, state.size, 1, 0, GL_RGBA, GL_FLOAT, zeros.data());
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+			glBindFramebuffer(GL_FRAMEBUFFER, state.frameBuffers[i]);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, state.textures[i], 0);
+			if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+				WARN("GLProcessor: State framebuffer for '%s' is not complete", state.name.c_str());
+			}
+		}
+		stateTextures.push_back(state);
+		//INFO("GLProcessor: Created state '%s' (%d texels)", state.name.c_str(), state.size);
 	}
-	
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	gl::checkError("setupStateTextures");
+}
+
+void GLProcessor::deleteStateTextures() {
+	for (StateTexture& state : stateTextures) {
+		glDeleteFramebuffers(2, state.frameBuffers);
+		glDeleteTextures(2, state.textures);
+	}
+	stateTextures.clear();
+}
+
+void GLProcessor::bindStateTextures() {
+	for (size_t i = 0; i < stateTextures.size(); i++) {
+		StateTexture& state = stateTextures[i];
+		glActiveTexture(GL_TEXTURE0 + i);
+		glBindTexture(GL_TEXTURE_2D, state.textures[state.readIndex]);
+		if (state.samplerUniform >= 0) glUniform1i(state.samplerUniform, i);
+	}
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void GLProcessor::drawQuad() {
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	if (posAttrib >= 0) {
+		glEnableVertexAttribArray(posAttrib);
+		glVertexAttribPointer(posAttrib, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+	}
+
+	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+
+	if (posAttrib >= 0) {
+		glDisableVertexAttribArray(posAttrib);
+	}
+}
+
+// wraps a GLAZE fragment shader so it runs once per sample in a compute shader
+// or a transform feedback vertex shader. gl_FragCoord/gl_FragColor are emulated and
+// the per-sample uniforms become globals, so the same GLIB shader works unmodified
+static bool buildBlockShaderSource(const std::string& fragmentSource, bool compute, std::string& result) {
+	static const char* unsupported[] = {"gl_FragData", "discard", "dFdx", "dFdy", "fwidth"};
+	for (const char* name : unsupported) {
+		if (glsl::containsIdentifier(fragmentSource, name)) return false;
+	}
+
+	std::string versionLine;
+	std::string body = glsl::splitVersion(fragmentSource, versionLine);
+	body = glsl::stripQualifier(body, "varying");
+	body = glsl::replaceIdentifier(body, "main", "glaze_main");
+	body = glsl::replaceIdentifier(body, "gl_FragColor", "glaze_FragColor");
+	body = glsl::replaceIdentifier(body, "gl_FragCoord", "glaze_FragCoord");
+
+	static const char* perSample[] = {"audioInL", "audioInR", "u1", "u2", "u3"};
+	static const char* components[] = {"glaze_InA.x", "glaze_InA.y", "glaze_InA.z", "glaze_InA.w", "glaze_InB.x"};
+	std::string assignments;
+	for (int i = 0; i < 5; i++) {
+		if (glsl::demoteUniform(body, perSample[i])) {
+			assignments += string::f("    %s = %s;\n", perSample[i], components[i]);
+		} else if (glsl::containsIdentifier(body, perSample[i])) {
+			return false;
+		}
+	}
+
+	std::string header;
+	std::string entry;
+	if (compute) {
+		header =
+			"#version 430 compatibility\n"
+			"layout(local_size_x = " + std::to_string(GLProcessor::COMPUTE_GROUP_SIZE) + ") in;\n"
+			"layout(std430, binding = 0) readonly buffer GlazeInput { vec4 glaze_Input[]; };\n"
+			"layout(std430, binding = 1) writeonly buffer GlazeOutput { vec2 glaze_Output[]; };\n"
+			"uniform int glaze_Count;\n";
+		entry =
+			"void main() {\n"
+			"    int i = int(gl_GlobalInvocationID.x);\n"
+			"    if (i >= glaze_Count) return;\n"
+			"    vec4 glaze_InA = glaze_Input[i * 2];\n"
+			"    vec4 glaze_InB = glaze_Input[i * 2 + 1];\n"
+			+ assignments +
+			"    glaze_FragCoord = vec4(0.5, 0.5, 0.0, 1.0);\n"
+			"    glaze_main();\n"
+			"    float left = glaze_FragColor.r;\n"
+			"    glaze_FragCoord = vec4(1.5, 0.5, 0.0, 1.0);\n"
+			"    glaze_main();\n"
+			"    glaze_Output[i] = vec2(left, glaze_FragColor.r);\n"
+			"}\n";
+	} else {
+		header =
+			(versionLine.empty() ? std::string("#version 120") : versionLine) + "\n"
+			"attribute vec4 glaze_InA;\n"
+			"attribute vec4 glaze_InB;\n"
+			"varying vec2 glaze_Output;\n";
+		entry =
+			"void main() {\n"
+			+ assignments +
+			"    glaze_FragCoord = vec4(0.5, 0.5, 0.0, 1.0);\n"
+			"    glaze_main();\n"
+			"    float left = glaze_FragColor.r;\n"
+			"    glaze_FragCoord = vec4(1.5, 0.5, 0.0, 1.0);\n"
+			"    glaze_main();\n"
+			"    glaze_Output = vec2(left, glaze_FragColor.r);\n"
+			"    gl_Position = vec4(0.0, 0.0, 0.0, 1.0);\n"
+			"}\n";
+	}
+	header +=
+		"vec4 glaze_FragCoord;\n"
+		"vec4 glaze_FragColor;\n";
+
+	result = header + body + "\n" + entry;
+	return true;
+}
+
+bool GLProcessor::createBlockBackend(const std::string& fragmentSource, int backend) {
+	bool compute = backend == Glaze::GPU_BACKEND_COMPUTE;
+	if (compute && !(GLEW_VERSION_4_3 || (GLEW_ARB_compute_shader && GLEW_ARB_shader_storage_buffer_object))) return false;
+	if (!compute && !GLEW_VERSION_3_0) return false;
+
+	std::string source;
+	if (!buildBlockShaderSource(fragmentSource, compute, source)) {
+		//INFO("GLProcessor: Shader uses fragment-only features, skipping block backend %d", backend);
+		return false;
+	}
+
+	GLuint shader = gl::compileShader(source, compute ? GL_COMPUTE_SHADER : GL_VERTEX_SHADER);
+	if (!shader) {
+		INFO("GLProcessor: Block backend %d unavailable for this shader, falling back", backend);
+		return false;
+	}
+
+	blockProgram = glCreateProgram();
+	glAttachShader(blockProgram, shader);
+	if (!compute) {
+		const char* varyings[] = {"glaze_Output"};
+		glTransformFeedbackVaryings(blockProgram, 1, varyings, GL_INTERLEAVED_ATTRIBS);
+	}
+	glLinkProgram(blockProgram);
+	glDeleteShader(shader);
+
+	GLint ok;
+	glGetProgramiv(blockProgram, GL_LINK_STATUS, &ok);
+	if (!ok) {
+		GLchar infoLog[512];
+		glGetProgramInfoLog(blockProgram, sizeof(infoLog), NULL, infoLog);
+		INFO("GLProcessor: Block backend %d linking failed: %s", backend, infoLog);
+		deleteBlockBackend();
+		return false;
+	}
+
+	blockCountUniform = glGetUniformLocation(blockProgram, "glaze_Count");
+	blockModeUniform = glGetUniformLocation(blockProgram, "mode");
+	blockFeatureUniforms[0].locate(blockProgram, 1);
+	blockFeatureUniforms[1].locate(blockProgram, 2);
+	blockInputAttribs[0] = compute ? -1 : glGetAttribLocation(blockProgram, "glaze_InA");
+	blockInputAttribs[1] = compute ? -1 : glGetAttribLocation(blockProgram, "glaze_InB");
+
+	blockInput.assign(MAX_BLOCK_SIZE * 8, 0.f);
+	blockOutput.assign(MAX_BLOCK_SIZE * 2, 0.f);
+	GLenum inputTarget = compute ? GL_SHADER_STORAGE_BUFFER : GL_ARRAY_BUFFER;
+	GLenum outputTarget = compute ? GL_SHADER_STORAGE_BUFFER : GL_TRANSFORM_FEEDBACK_BUFFER;
+	glGenBuffers(1, &blockInputBuffer);
+	glBindBuffer(inputTarget, blockInputBuffer);
+	glBufferData(inputTarget, blockInput.size() * sizeof(float), NULL, GL_STREAM_DRAW);
+	glGenBuffers(1, &blockOutputBuffer);
+	glBindBuffer(outputTarget, blockOutputBuffer);
+	glBufferData(outputTarget, blockOutput.size() * sizeof(float), NULL, GL_STREAM_READ);
+	glBindBuffer(inputTarget, 0);
+	glBindBuffer(outputTarget, 0);
+
+	gl::checkError("createBlockBackend");
+	return true;
+}
+
+void GLProcessor::deleteBlockBackend() {
+	if (blockProgram) glDeleteProgram(blockProgram);
+	if (blockInputBuffer) glDeleteBuffers(1, &blockInputBuffer);
+	if (blockOutputBuffer) glDeleteBuffers(1, &blockOutputBuffer);
+	blockProgram = 0;
+	blockInputBuffer = 0;
+	blockOutputBuffer = 0;
+}
+
+void GLProcessor::processBlock() {
+	if (!blockProgram) return;
+
+	size_t count = inputFrames.size();
+	if (count > MAX_BLOCK_SIZE) count = MAX_BLOCK_SIZE;
+	if (count == 0) return;
+
+	int mode = 0;
+	for (size_t i = 0; i < count; i++) {
+		AudioFrame frame = inputFrames.shift();
+		float* in = &blockInput[i * 8];
+		in[0] = frame.inL;
+		in[1] = frame.inR;
+		in[2] = frame.u1;
+		in[3] = frame.u2;
+		in[4] = frame.u3;
+		mode = frame.mode;
+	}
+
+	glUseProgram(blockProgram);
+	if (blockModeUniform >= 0) glUniform1i(blockModeUniform, mode);
+	blockFeatureUniforms[0].set(module->features[0]);
+	blockFeatureUniforms[1].set(module->features[1]);
+
+	if (activeBackend == Glaze::GPU_BACKEND_COMPUTE) {
+		if (blockCountUniform >= 0) glUniform1i(blockCountUniform, (int)count);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, blockInputBuffer);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * 8 * sizeof(float), blockInput.data());
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, blockInputBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, blockOutputBuffer);
+		glDispatchCompute((count + COMPUTE_GROUP_SIZE - 1) / COMPUTE_GROUP_SIZE, 1, 1);
+		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, blockOutputBuffer);
+		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * 2 * sizeof(float), blockOutput.data());
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	} else {
+		glBindBuffer(GL_ARRAY_BUFFER, blockInputBuffer);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, count * 8 * sizeof(float), blockInput.data());
+		for (int i = 0; i < 2; i++) {
+			if (blockInputAttribs[i] < 0) continue;
+			glEnableVertexAttribArray(blockInputAttribs[i]);
+			glVertexAttribPointer(blockInputAttribs[i], 4, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(i * 4 * sizeof(float)));
+		}
+
+		glEnable(GL_RASTERIZER_DISCARD);
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, blockOutputBuffer);
+		glBeginTransformFeedback(GL_POINTS);
+		glDrawArrays(GL_POINTS, 0, count);
+		glEndTransformFeedback();
+		glDisable(GL_RASTERIZER_DISCARD);
+
+		for (int i = 0; i < 2; i++) {
+			if (blockInputAttribs[i] >= 0) glDisableVertexAttribArray(blockInputAttribs[i]);
+		}
+		glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, blockOutputBuffer);
+		glGetBufferSubData(GL_TRANSFORM_FEEDBACK_BUFFER, 0, count * 2 * sizeof(float), blockOutput.data());
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	for (size_t i = 0; i < count && !outputFrames.full(); i++) {
+		AudioFrame frame;
+		float outL = blockOutput[i * 2];
+		float outR = blockOutput[i * 2 + 1];
+		frame.outL = std::isfinite(outL) ? clamp(outL, -1.f, 1.f) : 0.f;
+		frame.outR = std::isfinite(outR) ? clamp(outR, -1.f, 1.f) : 0.f;
+		outputFrames.push(frame);
+	}
+
+	gl::checkError("processBlock");
+}
+
+void GLProcessor::gpuStep() {
 	if (dirty) {
 		createShaderProgram();
 	}
+	if (pendingProgram) {
+		installShaderProgram();
+	}
 
-	processShader();
-	
-	OpenGlWidget::step();
+	if (activeBackend == Glaze::GPU_BACKEND_FRAGMENT) {
+		processShader();
+	} else {
+		processBlock();
+	}
 }
 
 void GLProcessor::processShader() {
 	if (!shaderProgram || !frameBuffer || !renderTexture) return;
 
-	glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
-	glViewport(0, 0, 2, 1);
+	GLint previousFrameBuffer = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFrameBuffer);
 
 	glUseProgram(shaderProgram);
 
@@ -166,28 +483,51 @@ void GLProcessor::processShader() {
 	if (u2Uniform >= 0) glUniform1f(u2Uniform, currentFrame.u2);
 	if (u3Uniform >= 0) glUniform1f(u3Uniform, currentFrame.u3);
 	if (modeUniform >= 0) glUniform1i(modeUniform, currentFrame.mode);
-
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	if (posAttrib >= 0) {
-		glEnableVertexAttribArray(posAttrib);
-		glVertexAttribPointer(posAttrib, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+	if (passCountUniform >= 0) glUniform1i(passCountUniform, (int)stateTextures.size());
+	if (frameUniform >= 0) glUniform1i(frameUniform, frameCount);
+	featureUniforms[0].set(module->features[0]);
+	featureUniforms[1].set(module->features[1]);
+
+	// state passes: each one reads every state (its own from the previous frame,
+	// earlier ones already updated this frame) and writes its back buffer
+	for (size_t i = 0; i < stateTextures.size(); i++) {
+		StateTexture& state = stateTextures[i];
+		int writeIndex = 1 - state.readIndex;
+
+		bindStateTextures();
+		glBindFramebuffer(GL_FRAMEBUFFER, state.frameBuffers[writeIndex]);
+		glViewport(0, 0, state.size, 1);
+		if (passUniform >= 0) glUniform1i(passUniform, (int)i);
+		if (passSizeUniform >= 0) glUniform2f(passSizeUniform, (float)state.size, 1.f);
+		drawQuad();
+
+		state.readIndex = writeIndex;
 	}
 
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-	if (posAttrib >= 0) {
-		glDisableVertexAttribArray(posAttrib);
-	}
+	bindStateTextures();
+	glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+	glViewport(0, 0, 2, 1);
+	if (passUniform >= 0) glUniform1i(passUniform, (int)stateTextures.size());
+	if (passSizeUniform >= 0) glUniform2f(passSizeUniform, 2.f, 1.f);
+	drawQuad();
 
 	float result[8] = {0};
 	glReadPixels(0, 0, 2, 1, GL_RGBA, GL_FLOAT, result);
 
 	processedFrame.outL = std::isfinite(result[0]) ? clamp(result[0], -1.f, 1.f) : 0.f;
 	processedFrame.outR = std::isfinite(result[4]) ? clamp(result[4], -1.f, 1.f) : 0.f;
+	producedFrames++;
+
+	for (size_t i = 0; i < stateTextures.size(); i++) {
+		glActiveTexture(GL_TEXTURE0 + i);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	glActiveTexture(GL_TEXTURE0);
+	glBindFramebuffer(GL_FRAMEBUFFER, previousFrameBuffer);
+	frameCount++;
 }
 
-void GLProcessor::processAudio(float& outL, float& outR, float inL, float inR, float u1, float u2, float u3, int mode) {
+bool GLProcessor::processAudio(float& outL, float& outR, float inL, float inR, float u1, float u2, float u3, int mode) {
 	currentFrame.inL = inL;
 	currentFrame.inR = inR;
 	currentFrame.u1 = u1;
@@ -195,12 +535,47 @@ void GLProcessor::processAudio(float& outL, float& outR, float inL, float inR, f
 	currentFrame.u3 = u3;
 	currentFrame.mode = mode;
 
-	outL = processedFrame.outL;
-	outR = processedFrame.outR;
+	float sampleRate = module ? module->sampleRate : 44100.f;
+
+	if (activeBackend == Glaze::GPU_BACKEND_FRAGMENT) {
+		uint32_t produced = producedFrames;
+		if (produced != lastProducedFrame) {
+			lastProducedFrame = produced;
+			samplesSinceFrame = 0;
+		} else if (samplesSinceFrame < INT_MAX) {
+			samplesSinceFrame++;
+		}
+		outL = processedFrame.outL;
+		outR = processedFrame.outR;
+		return samplesSinceFrame < (int)(sampleRate * FRAGMENT_DEADLINE_SECONDS);
+	}
+
+	if (!inputFrames.full()) {
+		inputFrames.push(currentFrame);
+	}
+
+	// an empty jitter buffer is an underrun: report it until the buffer has refilled
+	if (blockBuffering) {
+		blockBuffering = outputFrames.size() < (size_t)(sampleRate * JITTER_BUFFER_SECONDS);
+	}
+	if (!blockBuffering) {
+		if (outputFrames.empty()) {
+			blockBuffering = true;
+		} else {
+			blockFrame = outputFrames.shift();
+		}
+	}
+
+	outL = blockFrame.outL;
+	outR = blockFrame.outR;
+	return !blockBuffering;
 }
 
 GLProcessor::~GLProcessor() {
-	if (shaderProgram) glDeleteProgram(shaderProgram);
+	deleteStateTextures();
+	deleteBlockBackend();
+	SharedShaderLibrary::getInstance().releaseProgram(shaderProgram);
+	SharedShaderLibrary::getInstance().releaseProgram(pendingProgram);
 	if (VBO) glDeleteBuffers(1, &VBO);
 	if (EBO) glDeleteBuffers(1, &EBO);
 	if (frameBuffer) glDeleteFramebuffers(1, &frameBuffer);
@@ -226,23 +601,23 @@ Glaze::Glaze() {
 
 	layer1Buffer.resize(bufferSize, 0.f);
 	layer2Buffer.resize(bufferSize, 0.f);
+}
 
-	shaderSub.glibId = -1;
-	shaderSub.shaderIndex = -1;
-	shaderSub.isValid = false;
-
-	shaderBuffer = new float[SHADER_BUFFER_SIZE];
-	for (int i = 0; i < SHADER_BUFFER_SIZE; i++) {
-		shaderBuffer[i] = static_cast<float>(i) / SHADER_BUFFER_SIZE;
-	}
+void Glaze::onAdd(const AddEvent& e) {
+	processor = new GLProcessor();
+	processor->setModule(this);
+	GpuScheduler::getInstance().add(processor);
 }
 
-Glaze::~Glaze() {
-	if (shaderBuffer) delete[] shaderBuffer;
+void Glaze::onRemove(const RemoveEvent& e) {
+	GpuScheduler::getInstance().remove(processor);
+	processor = nullptr;
 }
 
 void Glaze::onSampleRateChange(const SampleRateChangeEvent& e) {
 	sampleRate = e.sampleRate;
+	features[0].setSampleRate(sampleRate);
+	features[1].setSampleRate(sampleRate);
 }
 
 void Glaze::onReset() {
@@ -284,7 +659,6 @@ void Glaze::processMode() {
 
 void Glaze::onShaderSubscribe(int64_t glibId, int shaderIndex) {
 	//INFO("Glaze: Shader subscription received - Glib: %lld, Shader: %d", (long long)glibId, shaderIndex);
-	shaderDirty = true;
 	shaderEnabled = true;
 	if (processor) {
 		//INFO("Glaze: Marking processor as dirty");
@@ -294,44 +668,6 @@ void Glaze::onShaderSubscribe(int64_t glibId, int shaderIndex) {
 	}
 }
 
-void Glaze::processShader() {
-	if (shaderDirty) {
-		//INFO("Glaze: Processing shader update");
-		auto& shaderLib = SharedShaderLibrary::getInstance();
-		const ShaderSubscription* sub = shaderLib.getSubscription(id);
-		if (sub) {
-			shaderSub = *sub;
-			//INFO("Glaze: Updated subscription - Glib: %lld, Shader: %d, Valid: %d", (long long)shaderSub.glibId, shaderSub.shaderIndex, shaderSub.isValid);
-			
-			if (shaderSub.isValid) {
-				const ShaderPair* shaderPair = shaderLib.getShaderForModule(id);
-				if (shaderPair && shaderPair->isValid) {
-					//INFO("Glaze: Valid shader found: %s", shaderPair->name.c_str());
-					useShaderWaveshaping = true;
-				} else {
-					WARN("Glaze: No valid shader pair found");
-					useShaderWaveshaping = false;
-				}
-			} else {
-				WARN("Glaze: Invalid shader subscription");
-				useShaderWaveshaping = false;
-			}
-		} else {
-			WARN("Glaze: No shader subscription found");
-			useShaderWaveshaping = false;
-		}
-		
-		shaderDirty = false;
-	}
-}
-
-float Glaze::processShaderWaveshaping(float input) {
-	float index = (input + 1.f) * 0.5f * (SHADER_BUFFER_SIZE - 1);
-	int idx1 = static_cast<int>(index);
-	
-	return shaderBuffer[idx1];
-}
-
 void Glaze::processReverb(float input, std::vector<float>& buffer, float decay, float diffusion) {
 	if (buffer.size() != static_cast<size_t>(bufferSize)) return;
 
@@ -580,9 +916,131 @@ float Glaze::processSpectral(float input, std::vector<float>& specBuf, std::vect
 	return tanh(output * 1.5f);
 }
 
+void Glaze::processDsp(float inL, float inR, float u1, float u2, float u3, bool leftConnected, bool rightConnected, float& outL, float& outR, const ProcessArgs& args) {
+	switch (currentMode) {
+		case MODE_REV: {
+			float decay = 0.5f + u1 * 0.499f;   // [0.5, 0.999]
+			float diffusion = 0.2f + u2 * 0.7f; // [0.2, 0.9]
+
+			if (leftConnected) {
+				processReverb(inL, layer1Buffer, decay, diffusion);
+				outL = layer1Buffer[0];
+			}
+			if (rightConnected) {
+				processReverb(inR, layer2Buffer, decay, diffusion);
+				outR = layer2Buffer[0];
+			}
+			break;
+		}
+		case MODE_DLY: {
+			float delayTime = u1;           // [0, 1] (scaled by buffer size)
+			float feedback = u2 * 0.99f;    // [0, 0.99]
+			float modulation = u3;          // [0, 1]
+
+			if (leftConnected) {
+				processDelay(inL, layer1Buffer, delayTime, feedback, modulation, args);
+				outL = layer1Buffer[0];
+			}
+			if (rightConnected) {
+				processDelay(inR, layer2Buffer, delayTime * 1.01f, feedback, modulation, args);
+				outR = layer2Buffer[0];
+			}
+			break;
+		}
+		case MODE_FZZ: {
+			// the shader waveshaping table is only populated when a shader is active,
+			// and then this is the fallback path, so always use the real fuzz here
+			float drive = u1;
+			float shape = u2;
+			float tone = 0.1f + u3 * 0.89f;
+
+			if (leftConnected) {
+				outL = processFuzz(inL, drive, shape, tone, fuzzLastL);
+			}
+			if (rightConnected) {
+				outR = processFuzz(inR, drive, shape, tone, fuzzLastR);
+			}
+			break;
+		}
+		case MODE_GLD: {
+			float targetFreq = 0.25f + u1 * 4.f;        // [0.25, 4.0]
+			float glideSpeed = 0.001f + u2 * 0.099f;    // [0.001, 0.1]
+			float waveform = u3;                        // morph 
+
+			if (leftConnected) {
+				outL = processGlide(inL, glidePhaseL, glideLastFreqL, targetFreq, glideSpeed, waveform, args);
+			}
+			if (rightConnected) {
+				outR = processGlide(inR, glidePhaseR, glideLastFreqR, targetFreq * 1.003f, glideSpeed, waveform, args);
+			}
+			break;
+		}
+		case MODE_GRN: {
+			float density = u1;
+			float size = u2;
+			float pitch = u3;
+
+			float grainL = 0.f;
+			float grainR = 0.f;
+			if (leftConnected) {
+				processGrain(inL, layer1Buffer, grainL, grainR, density, size, pitch, args);
+				outL = grainL;
+				if (!rightConnected) outR = grainR;
+			}
+			if (rightConnected) {
+				float grainL2 = 0.f;
+				float grainR2 = 0.f;
+				processGrain(inR, layer2Buffer, grainL2, grainR2, density, size, pitch, args);
+				outR = grainR2;
+			}
+			break;
+		}
+		case MODE_FLD: {
+			float folds = u1;       // [1, 8] 
+			float symmetry = u2;
+			float bias = u3;
+
+			if (leftConnected) {
+				outL = processFold(inL, folds, symmetry, bias);
+			}
+			if (rightConnected) {
+				outR = processFold(inR, folds, symmetry, bias);
+			}
+			break;
+		}
+		case MODE_WRP: {
+			float amount = u1;     // [0, 1]
+			float shape = u2;      // [sin, exp]
+			float skew = u3;       // [-1, 1] 
+
+			if (leftConnected) {
+				outL = processWarp(inL, warpPhaseL, warpLastL, amount, shape, skew, args);
+			}
+			if (rightConnected) {
+				outR = processWarp(inR, warpPhaseR, warpLastR, amount, shape, skew * 1.02f, args);
+			}
+			break;
+		}
+		case MODE_SPC: {
+			float spread = u1 * 0.8f;      // [0, 0.8] 
+			float shift = u2 * 4.f - 2.f;  // [-2, 2] 
+			float smear = u3 * 0.9f;       // [0, 0.9] 
+
+			if (leftConnected) {
+				outL = processSpectral(inL, specBufL, specWindowL, spread, shift, smear);
+			}
+			if (rightConnected) {
+				outR = processSpectral(inR, specBufR, specWindowR, spread, shift * 1.1f, smear);
+			}
+			break;
+		}
+		case NUM_MODES:
+			break;
+	}
+}
+
 void Glaze::process(const ProcessArgs& args) {
 	processMode();
-	processShader();
 
 	bool leftConnected = inputs[INPUT_L].isConnected();
 	bool rightConnected = inputs[INPUT_R].isConnected();
@@ -598,6 +1056,8 @@ void Glaze::process(const ProcessArgs& args) {
 
 	inL = clamp(inL, -10.f, 10.f) / 10.f;
 	inR = clamp(inR, -10.f, 10.f) / 10.f;
+	features[0].process(inL);
+	features[1].process(inR);
 
 	float mix = params[PARAM_MIX].getValue() / 100.f;
 	if (inputs[INPUT_MIX].isConnected()) {
@@ -611,138 +1071,27 @@ void Glaze::process(const ProcessArgs& args) {
 	float outL = inL;
 	float outR = inR;
 
-	// try shader processing first if enabled
+	// shader processing first if enabled, crossfading to DSP whenever the GPU falls behind
+	float gpuL = 0.f;
+	float gpuR = 0.f;
+	bool gpuOk = false;
 	if (shaderEnabled && processor) {
-		processor->processAudio(outL, outR, inL, inR, u1, u2, u3, currentMode);
-	} else {
-		// fall back to DSP processing
-		switch (currentMode) {
-			case MODE_REV: {
-				float decay = 0.5f + u1 * 0.499f;   // [0.5, 0.999]
-				float diffusion = 0.2f + u2 * 0.7f; // [0.2, 0.9]
-
-				if (leftConnected) {
-					processReverb(inL, layer1Buffer, decay, diffusion);
-					outL = layer1Buffer[0];
-				}
-				if (rightConnected) {
-					processReverb(inR, layer2Buffer, decay, diffusion);
-					outR = layer2Buffer[0];
-				}
-				break;
-			}
-			case MODE_DLY: {
-				float delayTime = u1;           // [0, 1] (scaled by buffer size)
-				float feedback = u2 * 0.99f;    // [0, 0.99]
-				float modulation = u3;          // [0, 1]
-
-				if (leftConnected) {
-					processDelay(inL, layer1Buffer, delayTime, feedback, modulation, args);
-					outL = layer1Buffer[0];
-				}
-				if (rightConnected) {
-					processDelay(inR, layer2Buffer, delayTime * 1.01f, feedback, modulation, args);
-					outR = layer2Buffer[0];
-				}
-				break;
-			}
-			case MODE_FZZ: {
-				if (useShaderWaveshaping) {
-					if (leftConnected) {
-						outL = processShaderWaveshaping(inL);
-					}
-					if (rightConnected) {
-						outR = processShaderWaveshaping(inR);
-					}
-				} else {
-					float drive = u1;
-					float shape = u2;
-					float tone = 0.1f + u3 * 0.89f;
-
-					if (leftConnected) {
-						outL = processFuzz(inL, drive, shape, tone, fuzzLastL);
-					}
-					if (rightConnected) {
-						outR = processFuzz(inR, drive, shape, tone, fuzzLastR);
-					}
-				}
-				break;
-			}
-			case MODE_GLD: {
-				float targetFreq = 0.25f + u1 * 4.f;        // [0.25, 4.0]
-				float glideSpeed = 0.001f + u2 * 0.099f;    // [0.001, 0.1]
-				float waveform = u3;                        // morph 
-
-				if (leftConnected) {
-					outL = processGlide(inL, glidePhaseL, glideLastFreqL, targetFreq, glideSpeed, waveform, args);
-				}
-				if (rightConnected) {
-					outR = processGlide(inR, glidePhaseR, glideLastFreqR, targetFreq * 1.003f, glideSpeed, waveform, args);
-				}
-				break;
-			}
-			case MODE_GRN: {
-				float density = u1;
-				float size = u2;
-				float pitch = u3;
-
-				float grainL = 0.f;
-				float grainR = 0.f;
-				if (leftConnected) {
-					processGrain(inL, layer1Buffer, grainL, grainR, density, size, pitch, args);
-					outL = grainL;
-					if (!rightConnected) outR = grainR;
-				}
-				if (rightConnected) {
-					float grainL2 = 0.f;
-					float grainR2 = 0.f;
-					processGrain(inR, layer2Buffer, grainL2, grainR2, density, size, pitch, args);
-					outR = grainR2;
-				}
-				break;
-			}
-			case MODE_FLD: {
-				float folds = u1;       // [1, 8] 
-				float symmetry = u2;
-				float bias = u3;
-
-				if (leftConnected) {
-					outL = processFold(inL, folds, symmetry, bias);
-				}
-				if (rightConnected) {
-					outR = processFold(inR, folds, symmetry, bias);
-				}
-				break;
-			}
-			case MODE_WRP: {
-				float amount = u1;     // [0, 1]
-				float shape = u2;      // [sin, exp]
-				float skew = u3;       // [-1, 1] 
+		gpuOk = processor->processAudio(gpuL, gpuR, inL, inR, u1, u2, u3, currentMode);
+		if (gpuHealthy.load(std::memory_order_relaxed) && !gpuOk) {
+			gpuUnderruns++;
+		}
+	}
+	gpuHealthy.store(gpuOk, std::memory_order_relaxed);
 
-				if (leftConnected) {
-					outL = processWarp(inL, warpPhaseL, warpLastL, amount, shape, skew, args);
-				}
-				if (rightConnected) {
-					outR = processWarp(inR, warpPhaseR, warpLastR, amount, shape, skew * 1.02f, args);
-				}
-				break;
-			}
-			case MODE_SPC: {
-				float spread = u1 * 0.8f;      // [0, 0.8] 
-				float shift = u2 * 4.f - 2.f;  // [-2, 2] 
-				float smear = u3 * 0.9f;       // [0, 0.9] 
+	float fade = args.sampleTime / GPU_FALLBACK_FADE_SECONDS;
+	gpuGain = gpuOk ? std::min(gpuGain + fade, 1.f) : std::max(gpuGain - fade, 0.f);
 
-				if (leftConnected) {
-					outL = processSpectral(inL, specBufL, specWindowL, spread, shift, smear);
-				}
-				if (rightConnected) {
-					outR = processSpectral(inR, specBufR, specWindowR, spread, shift * 1.1f, smear);
-				}
-				break;
-			}
-			case NUM_MODES:
-				break;
-		}
+	// the DSP runs even while the GPU is healthy, so its delay and reverb lines
+	// hold current audio when the crossfade starts
+	processDsp(inL, inR, u1, u2, u3, leftConnected, rightConnected, outL, outR, args);
+	if (gpuGain > 0.f) {
+		outL = crossfade(outL, gpuL, gpuGain);
+		outR = crossfade(outR, gpuR, gpuGain);
 	}
 
 	outL = inL * (1.f - mix) + outL * mix;
@@ -755,6 +1104,7 @@ void Glaze::process(const ProcessArgs& args) {
 json_t* Glaze::dataToJson() {
 	json_t* rootJ = json_object();
 	json_object_set_new(rootJ, "currentMode", json_integer(currentMode));
+	json_object_set_new(rootJ, "gpuBackend", json_integer(gpuBackend));
 	return rootJ;
 }
 
@@ -763,6 +1113,10 @@ void Glaze::dataFromJson(json_t* rootJ) {
 	if (modeJ) {
 		currentMode = (Mode)json_integer_value(modeJ);
 	}
+	json_t* backendJ = json_object_get(rootJ, "gpuBackend");
+	if (backendJ) {
+		gpuBackend = clamp((int)json_integer_value(backendJ), 0, NUM_GPU_BACKENDS - 1);
+	}
 }
 
 struct GlazeWidget : ModuleWidget {
@@ -770,12 +1124,6 @@ struct GlazeWidget : ModuleWidget {
 		setModule(module);
 		setPanel(createPanel(asset::plugin(pluginInstance, "res/glaze.svg")));
 
-		GLProcessor* processor = new GLProcessor();
-		if (module) {
-			processor->setModule(module);
-		}
-		addChild(processor);
-
 		addChild(createWidget<ScrewSilver>(Vec(RACK_GRID_WIDTH, 0)));
 		addChild(createWidget<ScrewSilver>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, 0)));
 		addChild(createWidget<ScrewSilver>(Vec(RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
@@ -812,6 +1160,30 @@ struct GlazeWidget : ModuleWidget {
 		menu->addChild(new MenuSeparator);
 		menu->addChild(createMenuLabel("Shader"));
 		addShaderMenuItems(menu, module);
+
+		static const char* backendNames[] = {"Fragment", "Transform feedback", "Compute"};
+		std::string activeName;
+		if (module->processor) {
+			activeName = backendNames[module->processor->activeBackend - Glaze::GPU_BACKEND_FRAGMENT];
+		}
+		menu->addChild(createIndexSubmenuItem("GPU backend",
+			{"Auto", "Fragment", "Transform feedback (GL 3.0)", "Compute (GL 4.3)"},
+			[=]() { return module->gpuBackend; },
+			[=](int backend) {
+				module->gpuBackend = backend;
+				if (module->processor) module->processor->dirty = true;
+			}));
+		if (!activeName.empty()) {
+			menu->addChild(createMenuLabel("Active backend: " + activeName));
+		}
+		if (module->processor) {
+			menu->addChild(createMenuLabel("GPU memory: " + gl::formatBytes(module->processor->gpuMemory)));
+		}
+		if (module->shaderEnabled) {
+			menu->addChild(createMenuLabel(module->gpuHealthy.load(std::memory_order_relaxed) ? "Output: GPU" : "Output: CPU fallback"));
+			menu->addChild(createMenuLabel(string::f("GPU underruns: %d", module->gpuUnderruns.load())));
+			menu->addChild(createMenuItem("Reset underrun count", "", [=]() { module->gpuUnderruns = 0; }));
+		}
 	}
 };
 
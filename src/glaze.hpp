@@ -2,7 +2,10 @@
 #include "plugin.hpp"
 #include "shader_manager.hpp"
 #include "shader_menu.hpp"
-#include <widget/OpenGlWidget.hpp>
+#include "gpu_scheduler.hpp"
+#include "audio_features.hpp"
+#include <atomic>
+#include <climits>
 
 struct GLProcessor;
 
@@ -56,12 +59,10 @@ struct Glaze : Module, ShaderSubscriber {
 
     Mode currentMode = MODE_REV;
     dsp::SchmittTrigger modeTrigger;
-    ShaderSubscription shaderSub;
     std::vector<float> layer1Buffer;
     std::vector<float> layer2Buffer;
     int bufferSize = 4096;
     float sampleRate = 44100.f;
-    bool shaderDirty = false;
 
     float fuzzLastL = 0.f;
     float fuzzLastR = 0.f;
@@ -96,15 +97,32 @@ struct Glaze : Module, ShaderSubscriber {
     size_t specPos = 0;
     float specPhase = 0.f;
 
-    float* shaderBuffer = nullptr;
-    static const int SHADER_BUFFER_SIZE = 1024;
-    bool useShaderWaveshaping = false;
     GLProcessor* processor = nullptr;
     bool shaderEnabled = false;
 
+    enum GpuBackend {
+        GPU_BACKEND_AUTO,
+        GPU_BACKEND_FRAGMENT,
+        GPU_BACKEND_FEEDBACK,
+        GPU_BACKEND_COMPUTE,
+        NUM_GPU_BACKENDS
+    };
+    int gpuBackend = GPU_BACKEND_AUTO;
+
+    // u_Rms1, u_Peak1, ... for the left (1) and right (2) inputs
+    AudioFeatures features[2];
+
+    // watchdog: when the GPU misses its deadline the output crossfades to the
+    // CPU DSP of the current mode, and back once the GPU stream recovers
+    static constexpr float GPU_FALLBACK_FADE_SECONDS = 0.005f;
+    float gpuGain = 0.f;
+    std::atomic<bool> gpuHealthy{false};
+    std::atomic<int> gpuUnderruns{0};
+
     Glaze();
-    ~Glaze();
 
+    void onAdd(const AddEvent& e) override;
+    void onRemove(const RemoveEvent& e) override;
     void onSampleRateChange(const SampleRateChangeEvent& e) override;
     void onReset() override;
     void process(const ProcessArgs& args) override;
@@ -114,8 +132,7 @@ struct Glaze : Module, ShaderSubscriber {
     void onShaderSubscribe(int64_t glibId, int shaderIndex) override;
 
     void processMode();
-    void processShader();
-    float processShaderWaveshaping(float input);
+    void processDsp(float inL, float inR, float u1, float u2, float u3, bool leftConnected, bool rightConnected, float& outL, float& outR, const ProcessArgs& args);
     void processReverb(float input, std::vector<float>& buffer, float decay, float diffusion);
     void processDelay(float input, std::vector<float>& buffer, float delayTime, float feedback, float modulation, const ProcessArgs& args);
     float processFuzz(float input, float drive, float shape, float tone, float& lastSample);
@@ -126,14 +143,18 @@ struct Glaze : Module, ShaderSubscriber {
     float processSpectral(float input, std::vector<float>& specBuf, std::vector<float>& window, float spread, float shift, float smear);
 };
 
-struct GLProcessor : rack::widget::OpenGlWidget {
+// owned by the Glaze module and stepped by the GpuScheduler, so GPU processing
+// keeps running without a visible widget (or a window at all)
+struct GLProcessor : GpuJob {
     GLuint shaderProgram = 0;
+    // compiling in the CompileQueue; shaderProgram keeps running until it is linked
+    GLuint pendingProgram = 0;
+    ShaderPair pendingShader;
     GLuint VBO = 0;
     GLuint EBO = 0;
     GLuint frameBuffer = 0;
     GLuint renderTexture = 0;
     bool dirty = true;
-    bool initialized = false;
 
     GLint posAttrib = -1;
     GLint audioInLUniform = -1;
@@ -142,6 +163,28 @@ struct GLProcessor : rack::widget::OpenGlWidget {
     GLint u2Uniform = -1;
     GLint u3Uniform = -1;
     GLint modeUniform = -1;
+    GLint passUniform = -1;
+    GLint passCountUniform = -1;
+    GLint passSizeUniform = -1;
+    GLint frameUniform = -1;
+    AudioFeatureUniforms featureUniforms[2];
+
+    // persistent ping-pong state declared with `#pragma glaze state <name> [size]`.
+    // each state gets its own pass (u_Pass = index) rendered into a size x 1 RGBA32F
+    // texture; the final pass (u_Pass = u_PassCount) writes the 2 x 1 audio output.
+    // nothing is read back except the output pass, so state stays on the GPU
+    struct StateTexture {
+        std::string name;
+        int size = 1;
+        GLuint textures[2] = {0, 0};
+        GLuint frameBuffers[2] = {0, 0};
+        int readIndex = 0;
+        GLint samplerUniform = -1;
+    };
+    static const int MAX_STATE_TEXTURES = 8;
+    static const int MAX_STATE_SIZE = 16384;
+    std::vector<StateTexture> stateTextures;
+    int frameCount = 0;
 
     // thread-safe communication buffers
     struct AudioFrame {
@@ -157,6 +200,38 @@ struct GLProcessor : rack::widget::OpenGlWidget {
     
     AudioFrame currentFrame;
     AudioFrame processedFrame;
+
+    // block backends (compute shader / transform feedback) run the GLIB fragment
+    // shader once per sample instead of once per UI frame. the audio thread queues
+    // input frames, step() processes everything queued in one dispatch and queues
+    // the results back, which the audio thread plays from a small jitter buffer
+    static const size_t BLOCK_RING_SIZE = 8192;
+    static const size_t MAX_BLOCK_SIZE = 4096;
+    static const int COMPUTE_GROUP_SIZE = 64;
+    static constexpr float JITTER_BUFFER_SECONDS = 0.025f;
+    dsp::RingBuffer<AudioFrame, BLOCK_RING_SIZE> inputFrames;
+    dsp::RingBuffer<AudioFrame, BLOCK_RING_SIZE> outputFrames;
+    AudioFrame blockFrame;
+    bool blockBuffering = true;
+    std::atomic<int> activeBackend{Glaze::GPU_BACKEND_FRAGMENT};
+
+    // the fragment backend bumps producedFrames after every readback; the audio
+    // thread counts samples since it last changed and gives up on the GPU after
+    // FRAGMENT_DEADLINE_SECONDS, a few missed scheduler ticks
+    static constexpr float FRAGMENT_DEADLINE_SECONDS = 4 * GpuScheduler::TICK_SECONDS;
+    std::atomic<uint32_t> producedFrames{0};
+    uint32_t lastProducedFrame = 0;
+    int samplesSinceFrame = INT_MAX;
+
+    GLuint blockProgram = 0;
+    GLuint blockInputBuffer = 0;
+    GLuint blockOutputBuffer = 0;
+    GLint blockCountUniform = -1;
+    GLint blockModeUniform = -1;
+    AudioFeatureUniforms blockFeatureUniforms[2];
+    GLint blockInputAttribs[2] = {-1, -1};
+    std::vector<float> blockInput;
+    std::vector<float> blockOutput;
     
     Glaze* module = nullptr;
 
@@ -164,9 +239,19 @@ struct GLProcessor : rack::widget::OpenGlWidget {
     ~GLProcessor();
     void setModule(Glaze* mod);
     void createShaderProgram();
+    void installShaderProgram();
     void setupFramebuffer();
     void setupGeometry();
-    void step() override;
-    void processAudio(float& outL, float& outR, float inL, float inR, float u1, float u2, float u3, int mode);
+    void updateGpuMemory();
+    void setupStateTextures(const std::string& fragmentSource);
+    void deleteStateTextures();
+    void bindStateTextures();
+    void drawQuad();
+    bool createBlockBackend(const std::string& fragmentSource, int backend);
+    void deleteBlockBackend();
+    void processBlock();
+    void gpuStep() override;
+    // returns false while the GPU stream is underrunning
+    bool processAudio(float& outL, float& outR, float inL, float inR, float u1, float u2, float u3, int mode);
     void processShader(); // process shaders in render frame ONLY!!!!!!!
 }; 
@@ -1,17 +1,68 @@
 #include "plugin.hpp"
 #include "gl_utils.hpp"
 #include "shader_manager.hpp"
-#include <widget/OpenGlWidget.hpp>
+#include "gpu_scheduler.hpp"
 #include <string>
 #include <fstream>
 #include <sstream>
 #include "shader_menu.hpp"
+#include "shader_rewrite.hpp"
+#include "worker.hpp"
+#include "glsl_eval.hpp"
+#include <atomic>
+#include <deque>
+#include <memory>
 
 struct GLCVProcessor;
 
 class Glcv;
 void updateGlcvProcessor(Glcv* module);
 
+// single-cycle tables baked from the shader in wavetable mode. every jack and
+// voice has LEVELS octave-spaced band-limited copies: level k holds SIZE >> k
+// samples (already in volts) and only the harmonics below (SIZE / 2) >> k
+struct Wavetable {
+    static const int SIZE = 2048;
+    static const int LEVELS = 11;
+    static const int STRIDE = 2 * SIZE - (2 * SIZE >> LEVELS);
+
+    int voices = 1;
+    std::vector<float> samples;
+
+    static int levelOffset(int level) {
+        return 2 * SIZE - (2 * SIZE >> level);
+    }
+
+    float* getLevel(int jack, int voice, int level) {
+        return &samples[(size_t)(jack * voices + voice) * STRIDE + levelOffset(level)];
+    }
+
+    // the first level without harmonics at or above the engine's Nyquist
+    static int getMipLevel(float freq, float sampleRate) {
+        float maxHarmonic = sampleRate / 2.f / std::max(freq, 1e-3f);
+        int level = 0;
+        while (level < LEVELS - 1 && ((SIZE / 2) >> level) - 1 >= maxHarmonic) {
+            level++;
+        }
+        return level;
+    }
+
+    float sample(int jack, int voice, int level, float phase) const {
+        const float* table = &samples[(size_t)(jack * voices + voice) * STRIDE + levelOffset(level)];
+        int size = SIZE >> level;
+        float position = phase * size;
+        int i = (int)position;
+        float frac = position - i;
+        i &= size - 1;
+        return crossfade(table[i], table[(i + 1) & (size - 1)], frac);
+    }
+};
+
+// at most one bake is built at a time
+struct WavetableSlot : Handoff<Wavetable> {
+    std::atomic<bool> building{false};
+};
+
 struct Glcv : Module, ShaderSubscriber {
 	enum ParamId {
 		PARAM_CHAOS,
@@ -22,6 +73,7 @@ struct Glcv : Module, ShaderSubscriber {
 		 INPUT_CLK,
 		 INPUT_RST,
 		 INPUT_TS,
+		 INPUT_VOCT,
 		 INPUTS_LEN
 	};
 	enum OutputId {
@@ -47,11 +99,96 @@ struct Glcv : Module, ShaderSubscriber {
     int subscribedShaderIndex = -1;
     GLCVProcessor* processor = nullptr;
 
+    // the processor renders CV ahead of the engine, one texel per STRIP_TEXEL_SECONDS,
+    // and queues the texels here with their audio-time stamps. process() plays them
+    // back with linear interpolation, so the outputs don't depend on the UI frame rate
+    // cv[jack][voice]. stepTime >= 0 marks a clock/reset edge between the previous
+    // texel and this one: playback jumps there instead of interpolating
+    struct CVFrame {
+        double time = 0.0;
+        double stepTime = -1.0;
+        float cv[4][PORT_MAX_CHANNELS] = {};
+    };
+    static const size_t CV_RING_SIZE = 1024;
+    dsp::RingBuffer<CVFrame, CV_RING_SIZE> cvFrames;
+    CVFrame prevFrame;
+    CVFrame nextFrame;
+    std::atomic<double> audioTime{0.0};
+    int channels = 1;
+
+    // audioTime grows for as long as the module runs, but shaders see it as a
+    // float. wrapped to 128 s, u_Time resolves 2^-17 s (7.6 us), under a sample
+    // up to 96 kHz, where the raw time would lose sample accuracy after a few
+    // minutes at 48 kHz. shaders that must loop seamlessly should use periods
+    // that divide TIME_WRAP_SECONDS
+    static constexpr double TIME_WRAP_SECONDS = 128.0;
+    static float wrapTime(double time) {
+        // like GLSL's mod(), which the strip shader uses
+        double wrapped = std::fmod(time, TIME_WRAP_SECONDS);
+        return (float)(wrapped < 0.0 ? wrapped + TIME_WRAP_SECONDS : wrapped);
+    }
+
+    // every change of clockTime (clock edge or reset) is queued with the audio
+    // time of the sample it happened on, so the renderer can rebuild the count
+    // per texel. clockLatency delays playback so edges are known before the
+    // texels around them are rendered
+    struct ClockEvent {
+        double time = 0.0;
+        float clockTime = 0.f;
+    };
+    static const size_t CLOCK_RING_SIZE = 256;
+    dsp::RingBuffer<ClockEvent, CLOCK_RING_SIZE> clockEvents;
+    float clockLatency = 0.f;
+
+    // strip mode renders CV over time. wavetable mode renders one cycle of the
+    // shader (u_Time from 0 to 2pi) only when its inputs change and plays it
+    // back as an oscillator tracking V/OCT
+    enum OutputMode {
+        OUTPUT_MODE_STRIP,
+        OUTPUT_MODE_WAVETABLE,
+        OUTPUT_MODES_LEN
+    };
+    int outputMode = OUTPUT_MODE_STRIP;
+    Wavetable* wavetable = nullptr;
+    std::shared_ptr<WavetableSlot> wavetableSlot = std::make_shared<WavetableSlot>();
+    float wavePhases[PORT_MAX_CHANNELS] = {};
+
+    // shaders that fit the glsl::Program subset are compiled on the Worker and
+    // evaluated here once per sample (and voice) instead of on the GPU, unless
+    // cpuEvaluation is off. cpuActive tells the GPU job to stand by meanwhile
+    enum CpuInputId {
+        CPU_TIME,
+        CPU_CHAOS,
+        CPU_SCALE,
+        CPU_CLOCK_TIME,
+        CPU_CLOCK_ELAPSED,
+        CPU_TIME_SPACE,
+        CPU_TIME_STEP,
+        CPU_CHANNELS,
+        CPU_FRAG_X,
+        CPU_FRAG_Y,
+        CPU_INPUTS_LEN
+    };
+    bool cpuEvaluation = true;
+    glsl::Program* cpuProgram = nullptr;
+    std::shared_ptr<Handoff<glsl::Program>> cpuSlot = std::make_shared<Handoff<glsl::Program>>();
+    std::atomic<bool> cpuActive{false};
+    double lastClockEdgeTime = 0.0;
+
+    static const std::vector<std::string>& getCpuInputNames() {
+        static const std::vector<std::string> names = {
+            "u_Time", "u_Chaos", "u_Scale", "u_ClockTime", "u_ClockElapsed",
+            "u_TimeSpace", "u_TimeStep", "u_Channels", "gl_FragCoord.x", "gl_FragCoord.y"
+        };
+        return names;
+    }
+
 	Glcv() {
 		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
 		configInput(INPUT_CLK, "clock");
 		configInput(INPUT_RST, "reset");
 		configInput(INPUT_TS, "time/space toggle");
+		configInput(INPUT_VOCT, "V/OCT (wavetable mode)");
         configParam(PARAM_SCALE, 0.f, 1.f, 0.5f, "output scale", "%", 0.f, 100.f);
         configParam(PARAM_CHAOS, 0.f, 1.f, 0.f, "chaos amount", "%", 0.f, 100.f);
 		configOutput(OUTPUT_1, "cv #1");
@@ -60,7 +197,15 @@ struct Glcv : Module, ShaderSubscriber {
 		configOutput(OUTPUT_4, "cv #4");
 	}
 
+    ~Glcv() {
+        delete wavetable;
+        delete cpuProgram;
+    }
+
 	void process(const ProcessArgs& args) override {
+        double now = audioTime + args.sampleTime;
+        float lastClockTime = clockTime;
+
         float clockValue = inputs[INPUT_CLK].getVoltage();
         bool clockHigh = clockValue >= 1.f;
         bool clockTriggered = clockHigh && !lastClockValue;
@@ -75,11 +220,148 @@ struct Glcv : Module, ShaderSubscriber {
             clockTime += 1.f;
         }
 
+        if (clockTime != lastClockTime) {
+            lastClockEdgeTime = now;
+        }
+        if (clockTime != lastClockTime && !clockEvents.full()) {
+            ClockEvent event;
+            event.time = now;
+            event.clockTime = clockTime;
+            clockEvents.push(event);
+        }
+
         chaos = params[PARAM_CHAOS].getValue();
         scale = params[PARAM_SCALE].getValue();
         timeSpace = inputs[INPUT_TS].getVoltage() > 1.0f ? 1.0f : 0.0f;
+
+        // published after the events so the renderer never sees a time whose events are missing
+        audioTime = now;
+
+        cpuSlot->take(cpuProgram);
+        bool cpu = cpuEvaluation && outputMode == OUTPUT_MODE_STRIP && cpuProgram && cpuProgram->isValid;
+        if (cpu != cpuActive) {
+            cpuActive = cpu;
+        }
+
+        if (outputMode == OUTPUT_MODE_WAVETABLE) {
+            processWavetable(args);
+            return;
+        }
+        if (cpu) {
+            processCpu(args, now);
+            return;
+        }
+
+        double playTime = now - clockLatency;
+        while (nextFrame.time <= playTime && !cvFrames.empty()) {
+            prevFrame = nextFrame;
+            nextFrame = cvFrames.shift();
+        }
+        // holds the last texel if the renderer falls behind
+        float t = 1.f;
+        if (nextFrame.time > prevFrame.time) {
+            if (nextFrame.stepTime >= 0.0) {
+                t = playTime >= nextFrame.stepTime ? 1.f : 0.f;
+            } else {
+                t = clamp((float)((playTime - prevFrame.time) / (nextFrame.time - prevFrame.time)), 0.f, 1.f);
+            }
+        }
+        for (int i = 0; i < 4; i++) {
+            outputs[OUTPUT_1 + i].setChannels(channels);
+            for (int c = 0; c < channels; c++) {
+                outputs[OUTPUT_1 + i].setVoltage(crossfade(prevFrame.cv[i][c], nextFrame.cv[i][c], t), c);
+            }
+        }
 	}
 
+    void processCpu(const ProcessArgs& args, double now) {
+        glsl::Program& program = *cpuProgram;
+        program.setInput(CPU_TIME, wrapTime(now));
+        program.setInput(CPU_CHAOS, chaos);
+        program.setInput(CPU_SCALE, scale);
+        program.setInput(CPU_CLOCK_TIME, clockTime);
+        program.setInput(CPU_CLOCK_ELAPSED, (float)(now - lastClockEdgeTime));
+        program.setInput(CPU_TIME_SPACE, timeSpace);
+        program.setInput(CPU_TIME_STEP, args.sampleTime);
+        program.setInput(CPU_CHANNELS, (float)channels);
+        program.setInput(CPU_FRAG_X, 0.5f);
+
+        for (int i = 0; i < 4; i++) {
+            outputs[OUTPUT_1 + i].setChannels(channels);
+        }
+        // voices can only differ through gl_FragCoord.y
+        bool perVoice = program.usesInput(CPU_FRAG_Y);
+        for (int c = 0; c < channels; c++) {
+            if (c == 0 || perVoice) {
+                program.setInput(CPU_FRAG_Y, c + 0.5f);
+                program.run();
+            }
+            for (int i = 0; i < 4; i++) {
+                float value = program.getOutput(i);
+                outputs[OUTPUT_1 + i].setVoltage(std::isfinite(value) ? (value * 2.f - 1.f) * 10.f : 0.f, c);
+            }
+        }
+    }
+
+    void processWavetable(const ProcessArgs& args) {
+        wavetableSlot->take(wavetable);
+
+        for (int i = 0; i < 4; i++) {
+            outputs[OUTPUT_1 + i].setChannels(channels);
+        }
+        for (int c = 0; c < channels; c++) {
+            float pitch = inputs[INPUT_VOCT].getPolyVoltage(c);
+            float freq = clamp(dsp::FREQ_C4 * dsp::exp2_taylor5(pitch), 0.f, args.sampleRate / 2.f);
+            wavePhases[c] += freq * args.sampleTime;
+            wavePhases[c] -= std::floor(wavePhases[c]);
+
+            if (!wavetable) {
+                for (int i = 0; i < 4; i++) {
+                    outputs[OUTPUT_1 + i].setVoltage(0.f, c);
+                }
+                continue;
+            }
+            // a table baked for fewer voices repeats its last one until the next bake
+            int voice = std::min(c, wavetable->voices - 1);
+            int level = Wavetable::getMipLevel(freq, args.sampleRate);
+            for (int i = 0; i < 4; i++) {
+                outputs[OUTPUT_1 + i].setVoltage(wavetable->sample(i, voice, level, wavePhases[c]), c);
+            }
+        }
+    }
+
+    json_t* dataToJson() override {
+        json_t* rootJ = json_object();
+        json_object_set_new(rootJ, "channels", json_integer(channels));
+        json_object_set_new(rootJ, "clockLatency", json_real(clockLatency));
+        json_object_set_new(rootJ, "outputMode", json_integer(outputMode));
+        json_object_set_new(rootJ, "cpuEvaluation", json_boolean(cpuEvaluation));
+        return rootJ;
+    }
+
+    void dataFromJson(json_t* rootJ) override {
+        json_t* channelsJ = json_object_get(rootJ, "channels");
+        if (channelsJ) {
+            channels = clamp((int)json_integer_value(channelsJ), 1, PORT_MAX_CHANNELS);
+        }
+        json_t* latencyJ = json_object_get(rootJ, "clockLatency");
+        if (latencyJ) {
+            clockLatency = clamp((float)json_number_value(latencyJ), 0.f, 1.f);
+        }
+        json_t* outputModeJ = json_object_get(rootJ, "outputMode");
+        if (outputModeJ) {
+            outputMode = clamp((int)json_integer_value(outputModeJ), 0, OUTPUT_MODES_LEN - 1);
+        }
+        json_t* cpuEvaluationJ = json_object_get(rootJ, "cpuEvaluation");
+        if (cpuEvaluationJ) {
+            cpuEvaluation = json_is_true(cpuEvaluationJ);
+        }
+    }
+
+    void onAdd(const AddEvent& e) override;
+    void onRemove(const RemoveEvent& e) override;
+    void compileCpuProgram();
+
 	void onReset() override {
         subscribedGlibId = -1;
         subscribedShaderIndex = -1;
@@ -108,15 +390,18 @@ struct Glcv : Module, ShaderSubscriber {
     }
 };
 
-struct GLCVProcessor : rack::widget::OpenGlWidget {
+// owned by the Glcv module and stepped by the GpuScheduler, so CV keeps
+// flowing without a visible widget (or a window at all)
+struct GLCVProcessor : GpuJob {
     GLuint shaderProgram = 0;
+    // compiling in the CompileQueue; shaderProgram keeps running until it is linked
+    GLuint pendingProgram = 0;
+    ShaderPair pendingShader;
     GLuint VBO = 0;
     GLuint EBO = 0;
     GLuint frameBuffer = 0;
-    GLuint renderTexture = 0;
-    float startTime = 0.f;
+    GLuint renderTextures[4] = {0, 0, 0, 0};
     bool dirty = true;
-    bool initialized = false;
     
     GLint posAttrib = -1;
     GLint timeUniform = -1;
@@ -124,13 +409,48 @@ struct GLCVProcessor : rack::widget::OpenGlWidget {
     GLint scaleUniform = -1;
     GLint clockTimeUniform = -1;
     GLint timeSpaceUniform = -1;
+    GLint timeBaseUniform = -1;
+    GLint timeStepUniform = -1;
+    GLint channelsUniform = -1;
+    GLint clockElapsedUniform = -1;
+    GLint clockTextureUniform = -1;
+
+    // each frame renders a W x H grid where column i is the shader at
+    // u_Time = u_TimeBase + i * u_TimeStep, enough to stay STRIP_LEAD_SECONDS
+    // ahead of the engine, and row j is voice j (gl_FragCoord.y).
+    // with `#pragma glcv mrt` the shader writes one target per jack through
+    // gl_FragData[0..3] instead, packing 4 voices per texel (row j = voices 4j..4j+3)
+    static const int MAX_STRIP_WIDTH = 512;
+    static constexpr float STRIP_TEXEL_SECONDS = 0.001f;
+    static constexpr float STRIP_LEAD_SECONDS = 0.1f;
+    // wavetable mode draws a whole cycle in one go
+    static const int MAX_GRID_WIDTH = Wavetable::SIZE > MAX_STRIP_WIDTH ? Wavetable::SIZE : MAX_STRIP_WIDTH;
+    double renderTime = 0.0;
+    bool multipleTargets = false;
+    std::vector<float> stripResult;
+
+    // what the last baked wavetable was rendered with; it is rebaked when any
+    // of these change and no build is in flight
+    int programGeneration = 0;
+    int tableGeneration = -1;
+    float tableChaos = 0.f;
+    float tableScale = 0.f;
+    float tableTimeSpace = 0.f;
+    float tableClockTime = 0.f;
+    int tableVoices = 0;
+
+    // clock events not yet consumed by a texel, and the per-texel clock state
+    // (r: u_ClockTime, g: u_ClockElapsed) uploaded alongside each strip
+    GLuint clockTexture = 0;
+    std::deque<Glcv::ClockEvent> pendingClockEvents;
+    float renderClockTime = 0.f;
+    double lastClockEventTime = 0.0;
+    std::vector<float> clockData;
+    std::vector<double> clockSteps;
     
     Glcv* module = nullptr;
     
     GLCVProcessor() {
-        box.size = math::Vec(1, 1);
-        visible = true;
-        startTime = rack::system::getTime();
     }
     
     void setModule(Glcv* mod) {
@@ -143,11 +463,6 @@ struct GLCVProcessor : rack::widget::OpenGlWidget {
     }
 
     void createShaderProgram() {
-        if (!initialized) {
-            WARN("Cannot create shader program - OpenGL context not initialized");
-            return;
-        }
-
         if (!module) {
             WARN("No module attached to GLCVProcessor");
             return;
@@ -160,8 +475,9 @@ struct GLCVProcessor : rack::widget::OpenGlWidget {
         
         auto& shaderLib = SharedShaderLibrary::getInstance();
         //INFO("Attempting to get subscription for module %lld", moduleId);
-        const ShaderSubscription* sub = shaderLib.getSubscription(moduleId);
-        if (!sub) {
+        ShaderSubscription subscription;
+        const ShaderSubscription* sub = &subscription;
+        if (!shaderLib.copySubscription(moduleId, subscription)) {
             //INFO("No subscription found for module %lld", moduleId);
             dirty = false;
             return;
@@ -184,8 +500,9 @@ struct GLCVProcessor : rack::widget::OpenGlWidget {
         }
         
         //INFO("Attempting to get shader for module %lld", moduleId);
-        const ShaderPair* shaderPair = shaderLib.getShaderForModule(moduleId);
-        if (!shaderPair) {
+        ShaderPair shader;
+        const ShaderPair* shaderPair = &shader;
+        if (!shaderLib.copyShaderForModule(moduleId, shader)) {
             WARN("No shader pair found for module %lld", moduleId);
             dirty = false;
             return;
@@ -198,56 +515,37 @@ struct GLCVProcessor : rack::widget::OpenGlWidget {
             return;
         }
         
-        if (shaderProgram) {
-            glDeleteProgram(shaderProgram);
-            shaderProgram = 0;
+        // replaces a request that is still compiling
+        shaderLib.releaseProgram(pendingProgram);
+        pendingShader = *shaderPair;
+        pendingProgram = shaderLib.acquireProgram(pendingShader.vertexSource, buildStripShaderSource(pendingShader.fragmentSource));
+        dirty = false;
+    }
+
+    void installShaderProgram() {
+        auto& shaderLib = SharedShaderLibrary::getInstance();
+        SharedShaderLibrary::ProgramStatus status = shaderLib.getProgramStatus(pendingProgram);
+        if (status == SharedShaderLibrary::PROGRAM_PENDING) return;
+        if (status == SharedShaderLibrary::PROGRAM_FAILED) {
+            shaderLib.releaseProgram(pendingProgram);
+            pendingProgram = 0;
+            return;
         }
+        shaderLib.releaseProgram(shaderProgram);
+        shaderProgram = pendingProgram;
+        pendingProgram = 0;
+        const ShaderPair* shaderPair = &pendingShader;
         
-        GLuint vertShader = 0, fragShader = 0;
         try {
-            vertShader = gl::compileShader(shaderPair->vertexSource, GL_VERTEX_SHADER);
-            if (!vertShader) {
-                WARN("Failed to compile vertex shader");
-                dirty = false;
-                return;
-            }
-            
-            fragShader = gl::compileShader(shaderPair->fragmentSource, GL_FRAGMENT_SHADER);
-            if (!fragShader) {
-                WARN("Failed to compile fragment shader");
-                glDeleteShader(vertShader);
-                dirty = false;
-                return;
+            multipleTargets = false;
+            for (const gl::Pragma& pragma : gl::parsePragmas(shaderPair->fragmentSource, "glcv")) {
+                if (pragma.directive == "mrt") {
+                    multipleTargets = true;
+                } else {
+                    WARN("GLCV: Unknown pragma directive '%s'", pragma.directive.c_str());
+                }
             }
-            
-            shaderProgram = glCreateProgram();
-            if (!shaderProgram) {
-                WARN("Failed to create shader program");
-                glDeleteShader(vertShader);
-                glDeleteShader(fragShader);
-                dirty = false;
-                return;
-            }
-            
-            glAttachShader(shaderProgram, vertShader);
-            glAttachShader(shaderProgram, fragShader);
-            glLinkProgram(shaderProgram);
-            
-            GLint ok;
-            glGetProgramiv(shaderProgram, GL_LINK_STATUS, &ok);
-            if (!ok) {
-                GLchar infoLog[512];
-                glGetProgramInfoLog(shaderProgram, 512, nullptr, infoLog);
-                WARN("Shader program linking failed: %s", infoLog);
-                glDeleteProgram(shaderProgram);
-                shaderProgram = 0;
-                dirty = false;
-                return;
-            }
-            
-            glDeleteShader(vertShader);
-            glDeleteShader(fragShader);
-            
+
             glUseProgram(shaderProgram);
             posAttrib = glGetAttribLocation(shaderProgram, "vs_Pos");
             timeUniform = glGetUniformLocation(shaderProgram, "u_Time");
@@ -255,24 +553,25 @@ struct GLCVProcessor : rack::widget::OpenGlWidget {
             scaleUniform = glGetUniformLocation(shaderProgram, "u_Scale");
             clockTimeUniform = glGetUniformLocation(shaderProgram, "u_ClockTime");
             timeSpaceUniform = glGetUniformLocation(shaderProgram, "u_TimeSpace");
+            timeBaseUniform = glGetUniformLocation(shaderProgram, "u_TimeBase");
+            timeStepUniform = glGetUniformLocation(shaderProgram, "u_TimeStep");
+            channelsUniform = glGetUniformLocation(shaderProgram, "u_Channels");
+            clockElapsedUniform = glGetUniformLocation(shaderProgram, "u_ClockElapsed");
+            clockTextureUniform = glGetUniformLocation(shaderProgram, "glcv_ClockTexture");
             
             setupFramebuffer();
+            setupClockTexture();
+            programGeneration++;
             
             setupGeometry();
+            updateGpuMemory();
             
-            gl::checkError("createShaderProgram");
-            //INFO("Successfully created shader program for module %lld", (long long)moduleId);
-            dirty = false;
+            gl::checkError("installShaderProgram");
         }
         catch (const std::exception& e) {
             WARN("Exception during shader program creation: %s", e.what());
-            if (vertShader) glDeleteShader(vertShader);
-            if (fragShader) glDeleteShader(fragShader);
-            if (shaderProgram) {
-                glDeleteProgram(shaderProgram);
-                shaderProgram = 0;
-            }
-            dirty = false;
+            shaderLib.releaseProgram(shaderProgram);
+            shaderProgram = 0;
         }
     }
 
@@ -281,20 +580,23 @@ struct GLCVProcessor : rack::widget::OpenGlWidget {
             glDeleteFramebuffers(1, &frameBuffer);
             frameBuffer = 0;
         }
-        if (renderTexture) {
-            glDeleteTextures(1, &renderTexture);
-            renderTexture = 0;
-        }
+        glDeleteTextures(4, renderTextures);
+        std::fill(renderTextures, renderTextures + 4, 0);
         
         glGenFramebuffers(1, &frameBuffer);
         glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
         
-        glGenTextures(1, &renderTexture);
-        glBindTexture(GL_TEXTURE_2D, renderTexture);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, 1, 1, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, renderTexture, 0);
+        int targets = getTargetCount();
+        int rows = multipleTargets ? PORT_MAX_CHANNELS / 4 : PORT_MAX_CHANNELS;
+        glGenTextures(targets, renderTextures);
+        for (int i = 0; i < targets; i++) {
+            glBindTexture(GL_TEXTURE_2D, renderTextures[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, MAX_GRID_WIDTH, rows, 0, GL_RGBA, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, renderTextures[i], 0);
+        }
+        stripResult.assign(targets * MAX_GRID_WIDTH * rows * 4, 0.f);
         
         if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
             WARN("Framebuffer is not complete!");
@@ -304,12 +606,92 @@ struct GLCVProcessor : rack::widget::OpenGlWidget {
         gl::checkError("setupFramebuffer");
     }
 
+    void setupClockTexture() {
+        if (clockTexture) {
+            glDeleteTextures(1, &clockTexture);
+            clockTexture = 0;
+        }
+        clockData.assign(MAX_STRIP_WIDTH * 4, 0.f);
+        clockSteps.assign(MAX_STRIP_WIDTH, -1.0);
+        if (clockTextureUniform < 0) return;
+
+        glGenTextures(1, &clockTexture);
+        glBindTexture(GL_TEXTURE_2D, clockTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, MAX_STRIP_WIDTH, 1, 0, GL_RGBA, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        // grids wider than the clock texture (wavetables) wrap around it
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        gl::checkError("setupClockTexture");
+    }
+
+    void updateGpuMemory() {
+        int rows = multipleTargets ? PORT_MAX_CHANNELS / 4 : PORT_MAX_CHANNELS;
+        size_t bytes = (size_t)getTargetCount() * MAX_GRID_WIDTH * rows * 16;
+        if (clockTexture) bytes += (size_t)MAX_STRIP_WIDTH * 16;
+        bytes += 20 * 4 + 6 * 4;
+        gpuMemory = bytes;
+    }
+
+    int getTargetCount() const {
+        return multipleTargets ? 4 : 1;
+    }
+
+    static std::string buildStripShaderSource(const std::string& fragmentSource);
     void setupGeometry();
-    void step() override;
-    void drawFramebuffer() override;
+    void gpuStep() override;
+    void skipClockEvents();
+    void drawGrid(int width, int rows, double timeBase, float timeStep);
+    float getVoltage(int jack, int voice, int texel, int width, int rows) const;
+    void renderStrip();
+    void renderWavetable();
     ~GLCVProcessor();
 };
 
+// turns u_Time, u_ClockTime and u_ClockElapsed into per-texel values so one
+// draw call covers a whole strip. uniforms that aren't declared on their own
+// are left alone and keep one value across the strip
+std::string GLCVProcessor::buildStripShaderSource(const std::string& fragmentSource) {
+    std::string versionLine;
+    std::string body = glsl::splitVersion(fragmentSource, versionLine);
+    if (!glsl::containsIdentifier(body, "main")) {
+        return fragmentSource;
+    }
+
+    std::string declarations;
+    std::string assignments;
+    if (glsl::demoteUniform(body, "u_Time")) {
+        declarations += "uniform float u_TimeBase;\n";
+        if (!glsl::containsIdentifier(body, "u_TimeStep")) {
+            declarations += "uniform float u_TimeStep;\n";
+        }
+        // wraps per texel, like the CPU path, so a strip crossing the wrap matches it
+        assignments += string::f("    u_Time = mod(u_TimeBase + floor(gl_FragCoord.x) * u_TimeStep, %.1f);\n", Glcv::TIME_WRAP_SECONDS);
+    }
+    bool clockTime = glsl::demoteUniform(body, "u_ClockTime");
+    bool clockElapsed = glsl::demoteUniform(body, "u_ClockElapsed");
+    if (clockTime || clockElapsed) {
+        declarations += "uniform sampler2D glcv_ClockTexture;\n";
+        assignments += string::f("    vec4 glcv_Clock = texture2D(glcv_ClockTexture, vec2((floor(gl_FragCoord.x) + 0.5) / %d.0, 0.5));\n", MAX_STRIP_WIDTH);
+        if (clockTime) assignments += "    u_ClockTime = glcv_Clock.r;\n";
+        if (clockElapsed) assignments += "    u_ClockElapsed = glcv_Clock.g;\n";
+    }
+    if (assignments.empty()) {
+        return fragmentSource;
+    }
+    body = glsl::replaceIdentifier(body, "main", "glcv_main");
+
+    std::string source = versionLine + "\n";
+    source += declarations;
+    source += body;
+    source += "\nvoid main() {\n";
+    source += assignments;
+    source += "    glcv_main();\n";
+    source += "}\n";
+    return source;
+}
+
 void GLCVProcessor::setupGeometry() {
     float vertices[] = {
         -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
@@ -322,56 +704,59 @@ void GLCVProcessor::setupGeometry() {
         1, 3, 2
     };
     
-    glGenBuffers(1, &VBO);
+    // every recompile comes through here, so the buffers are only created once
+    if (!VBO) glGenBuffers(1, &VBO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
     
-    glGenBuffers(1, &EBO);
+    if (!EBO) glGenBuffers(1, &EBO);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
     
     gl::checkError("setupGeometry");
 }
 
-void GLCVProcessor::step() {
-    if (!initialized) {
-        INFO("GLCVProcessor: Initializing OpenGL context");
-        OpenGlWidget::step();
-        initialized = true;
-        return;
-    }
-    
+void GLCVProcessor::gpuStep() {
     if (dirty) {
         //INFO("GLCVProcessor: Creating shader program due to dirty flag");
         createShaderProgram();
     }
-    
-    OpenGlWidget::step();
-}
+    if (pendingProgram) {
+        installShaderProgram();
+    }
 
-void GLCVProcessor::drawFramebuffer() {
-    if (!initialized) {
-        INFO("GLCVProcessor: OpenGL context not initialized yet");
-        return;
+    if (module && module->outputMode == Glcv::OUTPUT_MODE_WAVETABLE) {
+        renderWavetable();
+    } else {
+        renderStrip();
     }
+}
 
-    if (!shaderProgram) {
-        if (dirty) {
-            //INFO("GLCV: Creating shader program in drawFramebuffer");
-            createShaderProgram();
-            if (!shaderProgram) {
-                //INFO("GLCV: No shader program available, clearing to black");
-                glClearColor(0.0, 0.0, 0.0, 1.0);
-                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-                return;
-            }
-        } else {
-            return;
-        }
+// nothing to render, but keep the clock count current for the next strip
+void GLCVProcessor::skipClockEvents() {
+    while (!module->clockEvents.empty()) {
+        pendingClockEvents.push_back(module->clockEvents.shift());
+    }
+    while (!pendingClockEvents.empty()) {
+        renderClockTime = pendingClockEvents.front().clockTime;
+        lastClockEventTime = pendingClockEvents.front().time;
+        pendingClockEvents.pop_front();
     }
+}
+
+// draws a width x rows grid with u_Time stepping by timeStep from timeBase and
+// reads every target back into stripResult. the clock texture must already
+// hold the first min(width, MAX_STRIP_WIDTH) texels of clockData
+void GLCVProcessor::drawGrid(int width, int rows, double timeBase, float timeStep) {
+    int channels = clamp(module->channels, 1, PORT_MAX_CHANNELS);
+    int targets = getTargetCount();
+    static const GLenum drawBuffers[4] = {
+        GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3
+    };
 
     glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
-    glViewport(0, 0, 1, 1);
+    glDrawBuffers(targets, drawBuffers);
+    glViewport(0, 0, width, rows);
     
     glUseProgram(shaderProgram);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
@@ -384,52 +769,255 @@ void GLCVProcessor::drawFramebuffer() {
         WARN("GLCV: Position attribute not found in shader");
     }
     
-    float currentTime = rack::system::getTime() - startTime;
-    if (timeUniform >= 0) {
-        glUniform1f(timeUniform, currentTime);
+    if (timeBaseUniform >= 0) {
+        glUniform1f(timeBaseUniform, Glcv::wrapTime(timeBase));
+        if (timeStepUniform >= 0) glUniform1f(timeStepUniform, timeStep);
+    } else if (timeUniform >= 0) {
+        glUniform1f(timeUniform, Glcv::wrapTime(timeBase));
     } else {
         WARN("GLCV: Time uniform not found in shader");
     }
 
-    if (module) {
-        if (chaosUniform >= 0) glUniform1f(chaosUniform, module->chaos);
-        if (scaleUniform >= 0) glUniform1f(scaleUniform, module->scale);
-        if (clockTimeUniform >= 0) glUniform1f(clockTimeUniform, module->clockTime);
-        if (timeSpaceUniform >= 0) glUniform1f(timeSpaceUniform, module->timeSpace);
-    } else {
-        WARN("GLCV: No module attached in drawFramebuffer");
+    if (chaosUniform >= 0) glUniform1f(chaosUniform, module->chaos);
+    if (scaleUniform >= 0) glUniform1f(scaleUniform, module->scale);
+    if (clockTimeUniform >= 0) glUniform1f(clockTimeUniform, clockData[0]);
+    if (clockElapsedUniform >= 0) glUniform1f(clockElapsedUniform, clockData[1]);
+    if (clockTexture) {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, clockTexture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, std::min(width, (int)MAX_STRIP_WIDTH), 1, GL_RGBA, GL_FLOAT, clockData.data());
+        glUniform1i(clockTextureUniform, 0);
     }
+    if (timeSpaceUniform >= 0) glUniform1f(timeSpaceUniform, module->timeSpace);
+    if (channelsUniform >= 0) glUniform1f(channelsUniform, (float)channels);
     
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
     if (posAttrib >= 0) glDisableVertexAttribArray(posAttrib);
+    if (clockTexture) glBindTexture(GL_TEXTURE_2D, 0);
     
-    float result[4];
-    glReadPixels(0, 0, 1, 1, GL_RGBA, GL_FLOAT, result);
-    
-    // map [0,1] to [-10V, 10V]
-    if (module) {
-        module->outputs[Glcv::OUTPUT_1].setVoltage((result[0] * 2.0f - 1.0f) * 10.f);
-        module->outputs[Glcv::OUTPUT_2].setVoltage((result[1] * 2.0f - 1.0f) * 10.f);
-        module->outputs[Glcv::OUTPUT_3].setVoltage((result[2] * 2.0f - 1.0f) * 10.f);
-        module->outputs[Glcv::OUTPUT_4].setVoltage((result[3] * 2.0f - 1.0f) * 10.f);
-        /*
-        INFO("GLCV: Output voltages: %.2f, %.2f, %.2f, %.2f", 
-            module->outputs[Glcv::OUTPUT_1].getVoltage(),
-            module->outputs[Glcv::OUTPUT_2].getVoltage(),
-            module->outputs[Glcv::OUTPUT_3].getVoltage(),
-            module->outputs[Glcv::OUTPUT_4].getVoltage());
-        */
-    }
-
-    gl::checkError("drawFramebuffer");
+    size_t targetSize = (size_t)width * rows * 4;
+    for (int t = 0; t < targets; t++) {
+        glReadBuffer(GL_COLOR_ATTACHMENT0 + t);
+        glReadPixels(0, 0, width, rows, GL_RGBA, GL_FLOAT, &stripResult[t * targetSize]);
+    }
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glDrawBuffers(1, drawBuffers);
+}
+
+// maps texel [0,1] of the last drawn grid to [-10V, 10V]
+float GLCVProcessor::getVoltage(int jack, int voice, int texel, int width, int rows) const {
+    size_t targetSize = (size_t)width * rows * 4;
+    float value = multipleTargets
+        ? stripResult[jack * targetSize + ((voice / 4) * width + texel) * 4 + voice % 4]
+        : stripResult[(voice * width + texel) * 4 + jack];
+    return std::isfinite(value) ? (value * 2.0f - 1.0f) * 10.f : 0.f;
+}
+
+void GLCVProcessor::renderStrip() {
+    if (!module) {
+        WARN("GLCV: No module attached in renderStrip");
+        return;
+    }
+    if (module->cpuActive) {
+        skipClockEvents();
+        return;
+    }
+
+    if (!shaderProgram) {
+        skipClockEvents();
+        return;
+    }
+
+    while (!module->clockEvents.empty()) {
+        pendingClockEvents.push_back(module->clockEvents.shift());
+    }
+
+    // render just enough texels to stay STRIP_LEAD_SECONDS ahead of playback,
+    // restarting from the current play position after a stall. with clock sync
+    // latency, only render up to the engine time so every edge is already known
+    double audioTime = module->audioTime;
+    double playTime = audioTime - module->clockLatency;
+    double renderEnd = module->clockLatency > 0.f ? audioTime : audioTime + STRIP_LEAD_SECONDS;
+    if (renderTime < playTime) {
+        renderTime = playTime;
+    }
+    if (renderEnd < renderTime) return;
+    int width = (int)std::floor((renderEnd - renderTime) / STRIP_TEXEL_SECONDS) + 1;
+    width = std::min(width, (int)module->cvFrames.capacity());
+    width = std::min(width, (int)MAX_STRIP_WIDTH);
+    if (width <= 0) return;
+
+    // clock state at each texel. an edge between two texels is remembered so
+    // playback can jump on the exact sample instead of interpolating across it
+    for (int i = 0; i < width; i++) {
+        double texelTime = renderTime + i * STRIP_TEXEL_SECONDS;
+        clockSteps[i] = -1.0;
+        while (!pendingClockEvents.empty() && pendingClockEvents.front().time <= texelTime) {
+            const Glcv::ClockEvent& event = pendingClockEvents.front();
+            renderClockTime = event.clockTime;
+            lastClockEventTime = event.time;
+            if (event.time > texelTime - STRIP_TEXEL_SECONDS) {
+                clockSteps[i] = event.time;
+            }
+            pendingClockEvents.pop_front();
+        }
+        clockData[i * 4 + 0] = renderClockTime;
+        clockData[i * 4 + 1] = (float)(texelTime - lastClockEventTime);
+    }
+    bool usesClock = clockTextureUniform >= 0 || clockTimeUniform >= 0 || clockElapsedUniform >= 0;
+
+    int channels = clamp(module->channels, 1, PORT_MAX_CHANNELS);
+    int rows = multipleTargets ? (channels + 3) / 4 : channels;
+    drawGrid(width, rows, renderTime, STRIP_TEXEL_SECONDS);
+
+    for (int i = 0; i < width; i++) {
+        Glcv::CVFrame frame;
+        frame.time = renderTime + i * STRIP_TEXEL_SECONDS;
+        frame.stepTime = usesClock ? clockSteps[i] : -1.0;
+        for (int jack = 0; jack < 4; jack++) {
+            for (int c = 0; c < channels; c++) {
+                frame.cv[jack][c] = getVoltage(jack, c, i, width, rows);
+            }
+        }
+        module->cvFrames.push(frame);
+    }
+    renderTime += width * STRIP_TEXEL_SECONDS;
+
+    gl::checkError("renderStrip");
+}
+
+// runs on the Worker: one forward FFT per cycle, then one inverse FFT per mip
+// level with every bin from that level's Nyquist up cleared, decimated to the
+// level's size. the finished table is handed to the audio thread through slot
+static void buildWavetable(std::shared_ptr<WavetableSlot> slot, std::vector<float> cycles, int voices) {
+    const int size = Wavetable::SIZE;
+    Wavetable* table = new Wavetable;
+    table->voices = voices;
+    table->samples.assign((size_t)4 * voices * Wavetable::STRIDE, 0.f);
+
+    dsp::RealFFT fft(size);
+    float* cycle = (float*)pffft_aligned_malloc(size * sizeof(float));
+    float* spectrum = (float*)pffft_aligned_malloc(size * sizeof(float));
+    float* band = (float*)pffft_aligned_malloc(size * sizeof(float));
+    for (int jack = 0; jack < 4; jack++) {
+        for (int voice = 0; voice < voices; voice++) {
+            std::copy(&cycles[(size_t)(jack * voices + voice) * size], &cycles[(size_t)(jack * voices + voice + 1) * size], cycle);
+            fft.rfft(cycle, spectrum);
+            for (int level = 0; level < Wavetable::LEVELS; level++) {
+                // pffft packs DC and Nyquist into bin 0, then (re, im) pairs
+                int harmonics = (size / 2) >> level;
+                std::copy(spectrum, spectrum + 2 * harmonics, band);
+                std::fill(band + 2 * harmonics, band + size, 0.f);
+                band[1] = 0.f;
+                fft.irfft(band, cycle);
+                fft.scale(cycle);
+
+                float* samples = table->getLevel(jack, voice, level);
+                for (int i = 0; i < (size >> level); i++) {
+                    samples[i] = cycle[i << level];
+                }
+            }
+        }
+    }
+    pffft_aligned_free(cycle);
+    pffft_aligned_free(spectrum);
+    pffft_aligned_free(band);
+
+    slot->publish(table);
+    slot->building = false;
+}
+
+// bakes one cycle (u_Time from 0 to 2pi across Wavetable::SIZE texels) per
+// voice, but only when something the shader sees has changed since the last
+// bake. the clock uniforms hold their latest value across the cycle
+void GLCVProcessor::renderWavetable() {
+    if (!module) {
+        WARN("GLCV: No module attached in renderWavetable");
+        return;
+    }
+    skipClockEvents();
+    if (!shaderProgram) return;
+
+    int channels = clamp(module->channels, 1, PORT_MAX_CHANNELS);
+    bool changed = tableGeneration != programGeneration
+        || tableChaos != module->chaos
+        || tableScale != module->scale
+        || tableTimeSpace != module->timeSpace
+        || tableClockTime != renderClockTime
+        || tableVoices != channels;
+    if (!changed || module->wavetableSlot->building) return;
+
+    tableGeneration = programGeneration;
+    tableChaos = module->chaos;
+    tableScale = module->scale;
+    tableTimeSpace = module->timeSpace;
+    tableClockTime = renderClockTime;
+    tableVoices = channels;
+
+    for (int i = 0; i < MAX_STRIP_WIDTH; i++) {
+        clockData[i * 4 + 0] = renderClockTime;
+        clockData[i * 4 + 1] = 0.f;
+    }
+    int width = Wavetable::SIZE;
+    int rows = multipleTargets ? (channels + 3) / 4 : channels;
+    drawGrid(width, rows, 0.0, 2.f * M_PI / width);
+
+    std::vector<float> cycles((size_t)4 * channels * width);
+    for (int jack = 0; jack < 4; jack++) {
+        for (int c = 0; c < channels; c++) {
+            for (int i = 0; i < width; i++) {
+                cycles[(size_t)(jack * channels + c) * width + i] = getVoltage(jack, c, i, width, rows);
+            }
+        }
+    }
+    gl::checkError("renderWavetable");
+
+    module->wavetableSlot->building = true;
+    std::shared_ptr<WavetableSlot> slot = module->wavetableSlot;
+    Worker::getInstance().push([slot, cycles, channels]() {
+        buildWavetable(slot, cycles, channels);
+    });
 }
 
 GLCVProcessor::~GLCVProcessor() {
-    if (shaderProgram) glDeleteProgram(shaderProgram);
+    SharedShaderLibrary::getInstance().releaseProgram(shaderProgram);
+    SharedShaderLibrary::getInstance().releaseProgram(pendingProgram);
     if (VBO) glDeleteBuffers(1, &VBO);
     if (EBO) glDeleteBuffers(1, &EBO);
     if (frameBuffer) glDeleteFramebuffers(1, &frameBuffer);
-    if (renderTexture) glDeleteTextures(1, &renderTexture);
+    if (renderTextures[0]) glDeleteTextures(4, renderTextures);
+    if (clockTexture) glDeleteTextures(1, &clockTexture);
+}
+
+void Glcv::onAdd(const AddEvent& e) {
+    GLCVProcessor* job = new GLCVProcessor();
+    job->setModule(this);
+    GpuScheduler::getInstance().add(job);
+}
+
+void Glcv::onRemove(const RemoveEvent& e) {
+    GpuScheduler::getInstance().remove(processor);
+    processor = nullptr;
+}
+
+// runs on the Worker. an invalid program is published too, so a shader that
+// doesn't fit the subset replaces the previous one and GLCV goes back to the GPU
+void Glcv::compileCpuProgram() {
+    std::shared_ptr<Handoff<glsl::Program>> slot = cpuSlot;
+    int64_t moduleId = id;
+    Worker::getInstance().push([slot, moduleId]() {
+        glsl::Program* program = new glsl::Program;
+        ShaderPair shader;
+        if (SharedShaderLibrary::getInstance().copyShaderForModule(moduleId, shader) && shader.isValid) {
+            std::string error;
+            if (glsl::compileProgram(shader.fragmentSource, getCpuInputNames(), *program, error)) {
+                INFO("GLCV: Shader '%s' runs on the CPU (%d ops)", shader.name.c_str(), (int)program->ops.size());
+            } else {
+                INFO("GLCV: Shader '%s' runs on the GPU: %s", shader.name.c_str(), error.c_str());
+            }
+        }
+        slot->publish(program);
+    });
 }
 
 void updateGlcvProcessor(Glcv* module) {
@@ -437,6 +1025,7 @@ void updateGlcvProcessor(Glcv* module) {
         WARN("GLCV: Null module in updateGlcvProcessor");
         return;
     }
+    module->compileCpuProgram();
     
     if (!module->processor) {
         WARN("GLCV: No processor attached to module %lld", (long long)module->id);
@@ -462,10 +1051,6 @@ struct GlcvWidget : ModuleWidget {
 		setModule(module);
 		setPanel(createPanel(asset::plugin(pluginInstance, "res/glcv.svg")));
 
-		GLCVProcessor* processor = new GLCVProcessor();
-		processor->setModule(module);
-		addChild(processor);
-
 		addChild(createWidget<ScrewSilver>(Vec(RACK_GRID_WIDTH, 0)));
 		addChild(createWidget<ScrewSilver>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, 0)));
 		addChild(createWidget<ScrewSilver>(Vec(RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
@@ -474,6 +1059,7 @@ struct GlcvWidget : ModuleWidget {
 		addInput(createInputCentered<PJ301MPort>(mm2px(Vec(10.478, 14.552)), module, Glcv::INPUT_CLK));
 		addInput(createInputCentered<PJ301MPort>(mm2px(Vec(30.162, 14.552)), module, Glcv::INPUT_RST));
 		addInput(createInputCentered<PJ301MPort>(mm2px(Vec(10.478, 32.686)), module, Glcv::INPUT_TS));
+		addInput(createInputCentered<PJ301MPort>(mm2px(Vec(30.162, 53.49)), module, Glcv::INPUT_VOCT));
 		addParam(createParamCentered<RoundBlackKnob>(mm2px(Vec(10.478, 79.2)), module, Glcv::PARAM_CHAOS));
         addParam(createParamCentered<RoundBlackKnob>(mm2px(Vec(30.162, 116.965)), module, Glcv::PARAM_SCALE));
 		addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(30.162, 32.686)), module, Glcv::OUTPUT_1));
@@ -488,6 +1074,37 @@ struct GlcvWidget : ModuleWidget {
 			menu->addChild(createMenuLabel("Shader Source"));
 			
 			addShaderMenuItems(menu, module);
+
+			std::vector<std::string> channelLabels;
+			for (int c = 1; c <= PORT_MAX_CHANNELS; c++) {
+				channelLabels.push_back(string::f("%d", c));
+			}
+			Glcv* module = this->module;
+			menu->addChild(createIndexSubmenuItem("Polyphony channels", channelLabels,
+				[=]() { return module->channels - 1; },
+				[=](int index) { module->channels = index + 1; }));
+
+			static const float latencies[] = {0.f, 0.025f, 0.05f, 0.1f};
+			menu->addChild(createIndexSubmenuItem("Clock sync latency",
+				{"Off", "25 ms", "50 ms", "100 ms"},
+				[=]() {
+					for (int i = 3; i > 0; i--) {
+						if (module->clockLatency >= latencies[i]) return i;
+					}
+					return 0;
+				},
+				[=](int index) { module->clockLatency = latencies[index]; }));
+
+			menu->addChild(createIndexSubmenuItem("Output mode",
+				{"Strip", "Wavetable oscillator"},
+				[=]() { return module->outputMode; },
+				[=](int index) { module->outputMode = index; }));
+
+			menu->addChild(createBoolPtrMenuItem("Evaluate on the CPU when possible", "", &module->cpuEvaluation));
+			menu->addChild(createMenuLabel(module->cpuActive ? "Shader runs on the CPU" : "Shader runs on the GPU"));
+			if (module->processor) {
+				menu->addChild(createMenuLabel("GPU memory: " + gl::formatBytes(module->processor->gpuMemory)));
+			}
 		}
 	}
 };
@@ -0,0 +1,962 @@
+#include "glsl_eval.hpp"
+#include <map>
+#include <stdexcept>
+#include <cstring>
+#include <cctype>
+#include <cstdint>
+#include <algorithm>
+
+namespace glsl {
+
+namespace {
+
+struct Token {
+    enum Kind {
+        IDENT,
+        NUMBER,
+        SYMBOL,
+        END
+    };
+    Kind kind;
+    std::string text;
+    float number;
+};
+
+std::runtime_error unsupported(const std::string& what) {
+    return std::runtime_error(what);
+}
+
+// parsed by hand rather than with strtof, which follows the C locale
+float parseNumber(const std::string& source, size_t& i) {
+    double value = 0.0;
+    while (i < source.size() && std::isdigit((unsigned char)source[i])) {
+        value = value * 10.0 + (source[i++] - '0');
+    }
+    if (i < source.size() && source[i] == '.') {
+        i++;
+        double place = 0.1;
+        while (i < source.size() && std::isdigit((unsigned char)source[i])) {
+            value += (source[i++] - '0') * place;
+            place *= 0.1;
+        }
+    }
+    if (i < source.size() && (source[i] == 'e' || source[i] == 'E')) {
+        size_t start = i++;
+        int sign = 1;
+        if (i < source.size() && (source[i] == '+' || source[i] == '-')) {
+            sign = source[i++] == '-' ? -1 : 1;
+        }
+        if (i < source.size() && std::isdigit((unsigned char)source[i])) {
+            int exponent = 0;
+            while (i < source.size() && std::isdigit((unsigned char)source[i])) {
+                exponent = exponent * 10 + (source[i++] - '0');
+            }
+            value *= std::pow(10.0, sign * exponent);
+        } else {
+            i = start;
+        }
+    }
+    if (i < source.size() && (source[i] == 'f' || source[i] == 'F' || source[i] == 'u' || source[i] == 'U')) {
+        i++;
+    }
+    return (float)value;
+}
+
+std::vector<Token> tokenize(const std::string& source) {
+    static const char* twoCharSymbols[] = {
+        "==", "!=", "<=", ">=", "&&", "||", "^^", "+=", "-=", "*=", "/=", "++", "--"
+    };
+    std::vector<Token> tokens;
+    size_t i = 0;
+    size_t n = source.size();
+    while (i < n) {
+        char ch = source[i];
+        if (std::isspace((unsigned char)ch)) {
+            i++;
+            continue;
+        }
+        if (ch == '/' && i + 1 < n && source[i + 1] == '/') {
+            while (i < n && source[i] != '\n') i++;
+            continue;
+        }
+        if (ch == '/' && i + 1 < n && source[i + 1] == '*') {
+            size_t end = source.find("*/", i + 2);
+            if (end == std::string::npos) throw unsupported("unterminated comment");
+            i = end + 2;
+            continue;
+        }
+        if (ch == '#') {
+            size_t end = source.find('\n', i);
+            std::string line = source.substr(i, end == std::string::npos ? std::string::npos : end - i);
+            i = end == std::string::npos ? n : end;
+            // pragmas and macros can change what the rest of the source means
+            if (line.compare(0, 8, "#version") != 0) {
+                throw unsupported("preprocessor directive '" + line + "'");
+            }
+            continue;
+        }
+
+        Token token;
+        token.number = 0.f;
+        if (std::isalpha((unsigned char)ch) || ch == '_') {
+            size_t start = i;
+            while (i < n && (std::isalnum((unsigned char)source[i]) || source[i] == '_')) i++;
+            token.kind = Token::IDENT;
+            token.text = source.substr(start, i - start);
+        } else if (std::isdigit((unsigned char)ch) || (ch == '.' && i + 1 < n && std::isdigit((unsigned char)source[i + 1]))) {
+            size_t start = i;
+            token.kind = Token::NUMBER;
+            token.number = parseNumber(source, i);
+            token.text = source.substr(start, i - start);
+        } else {
+            token.kind = Token::SYMBOL;
+            token.text = std::string(1, ch);
+            for (const char* symbol : twoCharSymbols) {
+                if (i + 1 < n && ch == symbol[0] && source[i + 1] == symbol[1]) {
+                    token.text = symbol;
+                    break;
+                }
+            }
+            i += token.text.size();
+        }
+        tokens.push_back(token);
+    }
+    Token end;
+    end.kind = Token::END;
+    end.number = 0.f;
+    tokens.push_back(end);
+    return tokens;
+}
+
+int typeSize(const std::string& type) {
+    if (type == "float" || type == "bool") return 1;
+    if (type == "vec2") return 2;
+    if (type == "vec3") return 3;
+    if (type == "vec4") return 4;
+    return 0;
+}
+
+bool isPrecisionQualifier(const std::string& text) {
+    return text == "highp" || text == "mediump" || text == "lowp";
+}
+
+// a float/vecN/bool as the registers of its components
+struct Value {
+    int size = 0;
+    int regs[4] = {0, 0, 0, 0};
+};
+
+struct Function {
+    std::string name;
+    int returnSize = 0;
+    std::vector<int> paramSizes;
+    std::vector<std::string> paramNames;
+    size_t body = 0;
+};
+
+struct Builtin {
+    const char* name;
+    int code;
+    int arity;
+};
+
+const Builtin builtins[] = {
+    {"sin", Program::OP_SIN, 1},
+    {"cos", Program::OP_COS, 1},
+    {"tan", Program::OP_TAN, 1},
+    {"asin", Program::OP_ASIN, 1},
+    {"acos", Program::OP_ACOS, 1},
+    {"atan", Program::OP_ATAN, 1},
+    {"atan", Program::OP_ATAN2, 2},
+    {"pow", Program::OP_POW, 2},
+    {"exp", Program::OP_EXP, 1},
+    {"log", Program::OP_LOG, 1},
+    {"exp2", Program::OP_EXP2, 1},
+    {"log2", Program::OP_LOG2, 1},
+    {"sqrt", Program::OP_SQRT, 1},
+    {"inversesqrt", Program::OP_INVERSESQRT, 1},
+    {"abs", Program::OP_ABS, 1},
+    {"sign", Program::OP_SIGN, 1},
+    {"floor", Program::OP_FLOOR, 1},
+    {"ceil", Program::OP_CEIL, 1},
+    {"fract", Program::OP_FRACT, 1},
+    {"mod", Program::OP_MOD, 2},
+    {"min", Program::OP_MIN, 2},
+    {"max", Program::OP_MAX, 2},
+    {"clamp", Program::OP_CLAMP, 3},
+    {"mix", Program::OP_MIX, 3},
+    {"step", Program::OP_STEP, 2},
+    {"smoothstep", Program::OP_SMOOTHSTEP, 3},
+};
+
+// compiles by walking the tokens once per use: every call re-parses the
+// callee's body with its parameters bound to the argument registers, and
+// assignments just rebind names to registers, so the output needs no moves
+class Compiler {
+public:
+    Compiler(const std::vector<Token>& tokens, const std::vector<std::string>& inputNames, Program& program)
+        : tokens(tokens), inputNames(inputNames), program(program) {}
+
+    void compile() {
+        program.ops.clear();
+        program.registers.clear();
+        program.inputs.assign(inputNames.size(), -1);
+        isConstant.clear();
+        constant(0.f);
+
+        scopes.push_back(Scope());
+        Value fragColor;
+        fragColor.size = 4;
+        for (int i = 0; i < 4; i++) fragColor.regs[i] = constant(0.f);
+        scopes.back()["gl_FragColor"] = fragColor;
+        Value fragCoord;
+        fragCoord.size = 4;
+        fragCoord.regs[0] = input("gl_FragCoord.x", 0.5f);
+        fragCoord.regs[1] = input("gl_FragCoord.y", 0.5f);
+        fragCoord.regs[2] = constant(0.5f);
+        fragCoord.regs[3] = constant(1.f);
+        scopes.back()["gl_FragCoord"] = fragCoord;
+
+        while (peek().kind != Token::END) {
+            parseGlobal();
+        }
+
+        const Function* main = nullptr;
+        for (const Function& function : functions) {
+            if (function.name == "main" && function.paramSizes.empty()) main = &function;
+        }
+        if (!main) throw unsupported("no main()");
+        callFunction(*main, std::vector<Value>());
+
+        const Value& output = scopes.front()["gl_FragColor"];
+        for (int i = 0; i < 4; i++) {
+            program.outputs[i] = output.regs[i];
+        }
+        eliminateDeadCode();
+        if (program.ops.size() > MAX_OPS) {
+            throw unsupported("too many operations for the audio thread");
+        }
+        program.isValid = true;
+    }
+
+private:
+    typedef std::map<std::string, Value> Scope;
+
+    // a function being inlined. scopes below scopeBase belong to its callers
+    // and are invisible to it, except for the globals in scopes[0]
+    struct Frame {
+        int returnSize = 0;
+        size_t scopeBase = 0;
+        int branchDepth = 0;
+        bool returned = false;
+        Value result;
+    };
+
+    static const size_t MAX_OPS = 4096;
+    static const size_t MAX_CALL_DEPTH = 32;
+
+    const std::vector<Token>& tokens;
+    const std::vector<std::string>& inputNames;
+    Program& program;
+    size_t pos = 0;
+    std::vector<Scope> scopes;
+    std::vector<Frame> frames;
+    std::vector<Function> functions;
+    std::vector<bool> isConstant;
+    std::map<uint32_t, int> constants;
+
+    // tokens
+
+    const Token& peek(size_t offset = 0) const {
+        size_t i = std::min(pos + offset, tokens.size() - 1);
+        return tokens[i];
+    }
+
+    bool isNext(const char* text, size_t offset = 0) const {
+        const Token& token = peek(offset);
+        return token.kind != Token::END && token.kind != Token::NUMBER && token.text == text;
+    }
+
+    bool accept(const char* text) {
+        if (!isNext(text)) return false;
+        pos++;
+        return true;
+    }
+
+    void expect(const char* text) {
+        if (!accept(text)) {
+            throw unsupported(std::string("expected '") + text + "' before '" + peek().text + "'");
+        }
+    }
+
+    std::string expectIdent() {
+        if (peek().kind != Token::IDENT) {
+            throw unsupported("expected a name before '" + peek().text + "'");
+        }
+        return tokens[pos++].text;
+    }
+
+    void skipPrecision() {
+        while (peek().kind == Token::IDENT && isPrecisionQualifier(peek().text)) pos++;
+    }
+
+    int expectType() {
+        skipPrecision();
+        std::string type = expectIdent();
+        int size = typeSize(type);
+        if (!size) throw unsupported("type '" + type + "'");
+        return size;
+    }
+
+    void skipBlock() {
+        expect("{");
+        int depth = 1;
+        while (depth > 0) {
+            if (peek().kind == Token::END) throw unsupported("unterminated block");
+            if (isNext("{")) depth++;
+            if (isNext("}")) depth--;
+            pos++;
+        }
+    }
+
+    // registers
+
+    int newRegister(float value, bool constant) {
+        program.registers.push_back(value);
+        isConstant.push_back(constant);
+        return (int)program.registers.size() - 1;
+    }
+
+    int constant(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        auto it = constants.find(bits);
+        if (it != constants.end()) return it->second;
+        int reg = newRegister(value, true);
+        constants[bits] = reg;
+        return reg;
+    }
+
+    int input(const std::string& name, float fallback) {
+        for (size_t i = 0; i < inputNames.size(); i++) {
+            if (inputNames[i] == name) {
+                if (program.inputs[i] < 0) program.inputs[i] = newRegister(0.f, false);
+                return program.inputs[i];
+            }
+        }
+        return constant(fallback);
+    }
+
+    // folds ops on constants instead of emitting them
+    int emit(int code, int a, int b = 0, int c = 0) {
+        if (isConstant[a] && isConstant[b] && isConstant[c]) {
+            const std::vector<float>& r = program.registers;
+            return constant(Program::apply(code, r[a], r[b], r[c]));
+        }
+        if (code == Program::OP_SELECT && isConstant[a]) {
+            return program.registers[a] != 0.f ? b : c;
+        }
+        Program::Op op;
+        op.code = code;
+        op.dst = newRegister(0.f, false);
+        op.a = a;
+        op.b = b;
+        op.c = c;
+        program.ops.push_back(op);
+        return op.dst;
+    }
+
+    Value scalar(int reg) {
+        Value value;
+        value.size = 1;
+        value.regs[0] = reg;
+        return value;
+    }
+
+    // applies code per component, broadcasting scalar operands
+    Value componentwise(int code, const std::vector<Value>& args) {
+        int size = 1;
+        for (const Value& arg : args) size = std::max(size, arg.size);
+        for (const Value& arg : args) {
+            if (arg.size != 1 && arg.size != size) throw unsupported("mismatched vector sizes");
+        }
+        Value result;
+        result.size = size;
+        for (int i = 0; i < size; i++) {
+            int operands[3] = {0, 0, 0};
+            for (size_t j = 0; j < args.size(); j++) {
+                operands[j] = args[j].regs[args[j].size == 1 ? 0 : i];
+            }
+            result.regs[i] = emit(code, operands[0], operands[1], operands[2]);
+        }
+        return result;
+    }
+
+    Value componentwise(int code, const Value& a, const Value& b) {
+        std::vector<Value> args;
+        args.push_back(a);
+        args.push_back(b);
+        return componentwise(code, args);
+    }
+
+    int dot(const Value& a, const Value& b) {
+        if (a.size != b.size) throw unsupported("mismatched vector sizes");
+        int sum = emit(Program::OP_MUL, a.regs[0], b.regs[0]);
+        for (int i = 1; i < a.size; i++) {
+            sum = emit(Program::OP_ADD, sum, emit(Program::OP_MUL, a.regs[i], b.regs[i]));
+        }
+        return sum;
+    }
+
+    // names
+
+    Value* lookup(const std::string& name) {
+        size_t base = frames.empty() ? 1 : frames.back().scopeBase;
+        for (size_t i = scopes.size(); i > base; i--) {
+            auto it = scopes[i - 1].find(name);
+            if (it != scopes[i - 1].end()) return &it->second;
+        }
+        auto it = scopes.front().find(name);
+        return it != scopes.front().end() ? &it->second : nullptr;
+    }
+
+    std::vector<int> parseSwizzle(const std::string& swizzle, int size) {
+        static const char* sets[] = {"xyzw", "rgba", "stpq"};
+        std::vector<int> components;
+        for (const char* set : sets) {
+            components.clear();
+            for (char ch : swizzle) {
+                const char* found = std::strchr(set, ch);
+                if (!found || ch == '\0') break;
+                components.push_back((int)(found - set));
+            }
+            if (components.size() == swizzle.size()) break;
+        }
+        if (components.size() != swizzle.size() || components.empty() || components.size() > 4) {
+            throw unsupported("swizzle '." + swizzle + "'");
+        }
+        for (int component : components) {
+            if (component >= size) throw unsupported("swizzle '." + swizzle + "' out of range");
+        }
+        return components;
+    }
+
+    // top level
+
+    void parseGlobal() {
+        if (accept(";")) return;
+        if (accept("precision")) {
+            while (!accept(";")) {
+                if (peek().kind == Token::END) throw unsupported("unterminated precision statement");
+                pos++;
+            }
+            return;
+        }
+        bool uniform = accept("uniform");
+        if (!uniform) accept("const");
+        skipPrecision();
+        if (!uniform && accept("void")) {
+            parseFunction(0, expectIdent());
+            return;
+        }
+        int size = expectType();
+        std::string name = expectIdent();
+        if (!uniform && isNext("(")) {
+            parseFunction(size, name);
+            return;
+        }
+        if (uniform) {
+            while (true) {
+                bindUniform(name, size);
+                if (!accept(",")) break;
+                name = expectIdent();
+            }
+            expect(";");
+            return;
+        }
+        parseDeclarators(size, name);
+    }
+
+    void bindUniform(const std::string& name, int size) {
+        Value value;
+        value.size = size;
+        bool known = false;
+        for (const std::string& inputName : inputNames) {
+            known = known || inputName == name;
+        }
+        if (known && size != 1) throw unsupported("uniform '" + name + "' is not a float");
+        for (int i = 0; i < size; i++) {
+            value.regs[i] = known ? input(name, 0.f) : constant(0.f);
+        }
+        scopes.front()[name] = value;
+    }
+
+    void parseFunction(int returnSize, const std::string& name) {
+        Function function;
+        function.name = name;
+        function.returnSize = returnSize;
+        expect("(");
+        if (isNext("void") && isNext(")", 1)) pos++;
+        if (!accept(")")) {
+            do {
+                while (accept("in") || accept("const")) {}
+                if (isNext("out") || isNext("inout")) throw unsupported("out parameters");
+                function.paramSizes.push_back(expectType());
+                function.paramNames.push_back(expectIdent());
+            } while (accept(","));
+            expect(")");
+        }
+        if (accept(";")) return;
+        function.body = pos;
+        skipBlock();
+        functions.push_back(function);
+    }
+
+    Value callFunction(const Function& function, const std::vector<Value>& args) {
+        if (frames.size() >= MAX_CALL_DEPTH) throw unsupported("recursion");
+        size_t callerPos = pos;
+        pos = function.body;
+
+        Frame frame;
+        frame.returnSize = function.returnSize;
+        frame.scopeBase = scopes.size();
+        frames.push_back(frame);
+        scopes.push_back(Scope());
+        for (size_t i = 0; i < args.size(); i++) {
+            scopes.back()[function.paramNames[i]] = args[i];
+        }
+        parseBlock();
+        scopes.pop_back();
+        frame = frames.back();
+        frames.pop_back();
+        pos = callerPos;
+
+        if (function.returnSize && !frame.returned) {
+            throw unsupported("'" + function.name + "' does not end with a return");
+        }
+        return frame.result;
+    }
+
+    // statements
+
+    void parseBlock() {
+        expect("{");
+        scopes.push_back(Scope());
+        while (!accept("}")) {
+            if (peek().kind == Token::END) throw unsupported("unterminated block");
+            parseStatement();
+        }
+        scopes.pop_back();
+    }
+
+    void parseStatement() {
+        Frame& frame = frames.back();
+        if (frame.returned) throw unsupported("code after return");
+        if (isNext("{")) {
+            parseBlock();
+            return;
+        }
+        if (accept(";")) return;
+        if (accept("if")) {
+            parseIf();
+            return;
+        }
+        if (accept("return")) {
+            if (frame.branchDepth > 0) throw unsupported("return inside if");
+            if (frame.returnSize) {
+                Value value = parseExpression();
+                if (value.size != frame.returnSize) throw unsupported("return type mismatch");
+                frames.back().result = value;
+            }
+            frames.back().returned = true;
+            expect(";");
+            return;
+        }
+        const Token& token = peek();
+        if (token.kind == Token::IDENT) {
+            if (token.text == "for" || token.text == "while" || token.text == "do" || token.text == "discard"
+                || token.text == "break" || token.text == "continue" || token.text == "int") {
+                throw unsupported("'" + token.text + "'");
+            }
+            size_t start = pos;
+            accept("const");
+            skipPrecision();
+            if (typeSize(peek().text) && peek(1).kind == Token::IDENT) {
+                int size = expectType();
+                parseDeclarators(size, expectIdent());
+                return;
+            }
+            pos = start;
+        }
+        parseAssignment();
+        expect(";");
+    }
+
+    void parseDeclarators(int size, std::string name) {
+        while (true) {
+            if (isNext("[")) throw unsupported("arrays");
+            Value value;
+            value.size = size;
+            for (int i = 0; i < size; i++) value.regs[i] = constant(0.f);
+            if (accept("=")) {
+                value = parseExpression();
+                if (value.size != size) throw unsupported("type mismatch in '" + name + "'");
+            }
+            scopes.back()[name] = value;
+            if (!accept(",")) break;
+            name = expectIdent();
+        }
+        expect(";");
+    }
+
+    // both branches are compiled; afterwards every variable they assigned
+    // differently is merged with a select on the condition
+    void parseIf() {
+        expect("(");
+        Value condition = parseExpression();
+        expect(")");
+        if (condition.size != 1) throw unsupported("vector if condition");
+
+        frames.back().branchDepth++;
+        std::vector<Scope> before = scopes;
+        parseStatement();
+        std::vector<Scope> taken = scopes;
+        scopes = before;
+        if (accept("else")) {
+            parseStatement();
+        }
+        frames.back().branchDepth--;
+
+        for (size_t i = 0; i < before.size(); i++) {
+            for (auto& entry : before[i]) {
+                Value& otherwise = scopes[i][entry.first];
+                const Value& then = taken[i][entry.first];
+                for (int c = 0; c < otherwise.size; c++) {
+                    if (then.regs[c] != otherwise.regs[c]) {
+                        otherwise.regs[c] = emit(Program::OP_SELECT, condition.regs[0], then.regs[c], otherwise.regs[c]);
+                    }
+                }
+            }
+        }
+    }
+
+    void parseAssignment() {
+        if (peek().kind == Token::IDENT && lookup(peek().text)) {
+            size_t start = pos;
+            std::string name = expectIdent();
+            Value* target = lookup(name);
+            std::vector<int> components;
+            if (accept(".")) {
+                components = parseSwizzle(expectIdent(), target->size);
+            } else if (accept("[")) {
+                Value index = parseExpression();
+                expect("]");
+                if (index.size != 1 || !isConstant[index.regs[0]]) throw unsupported("dynamic indexing");
+                int i = (int)program.registers[index.regs[0]];
+                target = lookup(name);
+                if (i < 0 || i >= target->size) throw unsupported("index out of range");
+                components.push_back(i);
+            } else {
+                for (int i = 0; i < target->size; i++) components.push_back(i);
+            }
+            static const char* operators[] = {"=", "+=", "-=", "*=", "/="};
+            static const int codes[] = {-1, Program::OP_ADD, Program::OP_SUB, Program::OP_MUL, Program::OP_DIV};
+            for (int i = 0; i < 5; i++) {
+                if (!accept(operators[i])) continue;
+                Value current;
+                current.size = (int)components.size();
+                for (size_t c = 0; c < components.size(); c++) {
+                    current.regs[c] = target->regs[components[c]];
+                }
+                Value value = parseExpression();
+                if (codes[i] >= 0) value = componentwise(codes[i], current, value);
+                if (value.size != current.size) throw unsupported("type mismatch in assignment to '" + name + "'");
+                // the expression may have inlined calls that moved the scopes
+                target = lookup(name);
+                for (size_t c = 0; c < components.size(); c++) {
+                    target->regs[components[c]] = value.regs[c];
+                }
+                return;
+            }
+            pos = start;
+        }
+        // calls have no side effects, so a bare expression compiles to nothing
+        parseExpression();
+    }
+
+    // expressions, lowest precedence first
+
+    Value parseExpression() {
+        Value condition = parseLogical(0);
+        if (!accept("?")) return condition;
+        if (condition.size != 1) throw unsupported("vector ?: condition");
+        Value a = parseExpression();
+        expect(":");
+        Value b = parseExpression();
+        if (a.size != b.size) throw unsupported("mismatched ?: branches");
+        Value result;
+        result.size = a.size;
+        for (int i = 0; i < a.size; i++) {
+            result.regs[i] = emit(Program::OP_SELECT, condition.regs[0], a.regs[i], b.regs[i]);
+        }
+        return result;
+    }
+
+    // ||, ^^, && by level
+    Value parseLogical(int level) {
+        static const char* operators[] = {"||", "^^", "&&"};
+        static const int codes[] = {Program::OP_OR, Program::OP_NE, Program::OP_AND};
+        Value value = level < 2 ? parseLogical(level + 1) : parseEquality();
+        while (accept(operators[level])) {
+            Value rhs = level < 2 ? parseLogical(level + 1) : parseEquality();
+            if (value.size != 1 || rhs.size != 1) throw unsupported("vector logic");
+            if (codes[level] == Program::OP_NE) {
+                value = scalar(emit(Program::OP_NE, emit(Program::OP_NE, value.regs[0], constant(0.f)), emit(Program::OP_NE, rhs.regs[0], constant(0.f))));
+            } else {
+                value = scalar(emit(codes[level], value.regs[0], rhs.regs[0]));
+            }
+        }
+        return value;
+    }
+
+    Value parseEquality() {
+        Value value = parseRelational();
+        while (isNext("==") || isNext("!=")) {
+            bool equal = accept("==");
+            if (!equal) pos++;
+            Value rhs = parseRelational();
+            if (value.size != rhs.size) throw unsupported("mismatched vector sizes");
+            // vectors compare as a whole
+            int result = emit(Program::OP_EQ, value.regs[0], rhs.regs[0]);
+            for (int i = 1; i < value.size; i++) {
+                result = emit(Program::OP_AND, result, emit(Program::OP_EQ, value.regs[i], rhs.regs[i]));
+            }
+            value = scalar(equal ? result : emit(Program::OP_NOT, result));
+        }
+        return value;
+    }
+
+    Value parseRelational() {
+        static const char* operators[] = {"<", "<=", ">", ">="};
+        static const int codes[] = {Program::OP_LT, Program::OP_LE, Program::OP_GT, Program::OP_GE};
+        Value value = parseAdditive();
+        while (true) {
+            int code = -1;
+            for (int i = 0; i < 4; i++) {
+                if (accept(operators[i])) code = codes[i];
+            }
+            if (code < 0) return value;
+            Value rhs = parseAdditive();
+            if (value.size != 1 || rhs.size != 1) throw unsupported("vector comparison");
+            value = scalar(emit(code, value.regs[0], rhs.regs[0]));
+        }
+    }
+
+    Value parseAdditive() {
+        Value value = parseMultiplicative();
+        while (true) {
+            if (accept("+")) value = componentwise(Program::OP_ADD, value, parseMultiplicative());
+            else if (accept("-")) value = componentwise(Program::OP_SUB, value, parseMultiplicative());
+            else return value;
+        }
+    }
+
+    Value parseMultiplicative() {
+        Value value = parseUnary();
+        while (true) {
+            if (accept("*")) value = componentwise(Program::OP_MUL, value, parseUnary());
+            else if (accept("/")) value = componentwise(Program::OP_DIV, value, parseUnary());
+            else return value;
+        }
+    }
+
+    Value parseUnary() {
+        if (accept("+")) return parseUnary();
+        if (accept("-")) {
+            std::vector<Value> args(1, parseUnary());
+            return componentwise(Program::OP_NEG, args);
+        }
+        if (accept("!")) {
+            Value value = parseUnary();
+            if (value.size != 1) throw unsupported("vector '!'");
+            return scalar(emit(Program::OP_NOT, value.regs[0]));
+        }
+        return parsePostfix();
+    }
+
+    Value parsePostfix() {
+        Value value = parsePrimary();
+        while (true) {
+            if (accept(".")) {
+                std::vector<int> components = parseSwizzle(expectIdent(), value.size);
+                Value swizzled;
+                swizzled.size = (int)components.size();
+                for (size_t i = 0; i < components.size(); i++) {
+                    swizzled.regs[i] = value.regs[components[i]];
+                }
+                value = swizzled;
+            } else if (accept("[")) {
+                Value index = parseExpression();
+                expect("]");
+                if (index.size != 1 || !isConstant[index.regs[0]]) throw unsupported("dynamic indexing");
+                int i = (int)program.registers[index.regs[0]];
+                if (i < 0 || i >= value.size) throw unsupported("index out of range");
+                value = scalar(value.regs[i]);
+            } else {
+                return value;
+            }
+        }
+    }
+
+    Value parsePrimary() {
+        const Token& token = peek();
+        if (token.kind == Token::NUMBER) {
+            pos++;
+            return scalar(constant(token.number));
+        }
+        if (accept("(")) {
+            Value value = parseExpression();
+            expect(")");
+            return value;
+        }
+        if (token.kind != Token::IDENT) {
+            throw unsupported("unexpected '" + token.text + "'");
+        }
+        std::string name = expectIdent();
+        if (name == "true") return scalar(constant(1.f));
+        if (name == "false") return scalar(constant(0.f));
+        if (isNext("(")) {
+            return parseCall(name);
+        }
+        Value* value = lookup(name);
+        if (!value) throw unsupported("'" + name + "'");
+        return *value;
+    }
+
+    Value parseCall(const std::string& name) {
+        expect("(");
+        std::vector<Value> args;
+        if (!accept(")")) {
+            do {
+                args.push_back(parseExpression());
+            } while (accept(","));
+            expect(")");
+        }
+
+        if (int size = typeSize(name)) {
+            return construct(name, size, args);
+        }
+        for (const Function& function : functions) {
+            if (function.name != name || function.paramSizes.size() != args.size()) continue;
+            bool matches = true;
+            for (size_t i = 0; i < args.size(); i++) {
+                matches = matches && function.paramSizes[i] == args[i].size;
+            }
+            if (matches) return callFunction(function, args);
+        }
+        return callBuiltin(name, args);
+    }
+
+    Value construct(const std::string& type, int size, const std::vector<Value>& args) {
+        std::vector<int> components;
+        for (const Value& arg : args) {
+            for (int i = 0; i < arg.size; i++) components.push_back(arg.regs[i]);
+        }
+        if (components.empty()) throw unsupported("empty " + type + "()");
+        Value value;
+        value.size = size;
+        for (int i = 0; i < size; i++) {
+            if (components.size() == 1) {
+                value.regs[i] = components[0];
+            } else if ((size_t)i < components.size()) {
+                value.regs[i] = components[i];
+            } else {
+                throw unsupported("too few components for " + type + "()");
+            }
+        }
+        if (type == "bool") {
+            value.regs[0] = emit(Program::OP_NE, value.regs[0], constant(0.f));
+        }
+        return value;
+    }
+
+    Value callBuiltin(const std::string& name, const std::vector<Value>& args) {
+        for (const Builtin& builtin : builtins) {
+            if (name == builtin.name && (size_t)builtin.arity == args.size()) {
+                return componentwise(builtin.code, args);
+            }
+        }
+        if (name == "radians" || name == "degrees") {
+            if (args.size() != 1) throw unsupported("'" + name + "' arguments");
+            float factor = name == "radians" ? (float)(M_PI / 180.0) : (float)(180.0 / M_PI);
+            return componentwise(Program::OP_MUL, args[0], scalar(constant(factor)));
+        }
+        if (name == "dot" && args.size() == 2) {
+            return scalar(dot(args[0], args[1]));
+        }
+        if (name == "length" && args.size() == 1) {
+            return scalar(emit(Program::OP_SQRT, dot(args[0], args[0])));
+        }
+        if (name == "distance" && args.size() == 2) {
+            Value difference = componentwise(Program::OP_SUB, args[0], args[1]);
+            return scalar(emit(Program::OP_SQRT, dot(difference, difference)));
+        }
+        if (name == "normalize" && args.size() == 1) {
+            Value scale = scalar(emit(Program::OP_INVERSESQRT, dot(args[0], args[0])));
+            return componentwise(Program::OP_MUL, args[0], scale);
+        }
+        if (name == "cross" && args.size() == 2) {
+            const Value& a = args[0];
+            const Value& b = args[1];
+            if (a.size != 3 || b.size != 3) throw unsupported("cross() of non-vec3");
+            Value value;
+            value.size = 3;
+            for (int i = 0; i < 3; i++) {
+                int j = (i + 1) % 3;
+                int k = (i + 2) % 3;
+                value.regs[i] = emit(Program::OP_SUB,
+                    emit(Program::OP_MUL, a.regs[j], b.regs[k]),
+                    emit(Program::OP_MUL, a.regs[k], b.regs[j]));
+            }
+            return value;
+        }
+        throw unsupported("'" + name + "()'");
+    }
+
+    // drops ops whose results never reach gl_FragColor, and forgets inputs
+    // that only fed them
+    void eliminateDeadCode() {
+        std::vector<bool> live(program.registers.size(), false);
+        for (int i = 0; i < 4; i++) live[program.outputs[i]] = true;
+        std::vector<Program::Op> ops;
+        for (size_t i = program.ops.size(); i > 0; i--) {
+            const Program::Op& op = program.ops[i - 1];
+            if (!live[op.dst]) continue;
+            live[op.a] = live[op.b] = live[op.c] = true;
+            ops.push_back(op);
+        }
+        program.ops.assign(ops.rbegin(), ops.rend());
+        for (int& reg : program.inputs) {
+            if (reg >= 0 && !live[reg]) reg = -1;
+        }
+    }
+};
+
+} // namespace
+
+bool compileProgram(const std::string& source, const std::vector<std::string>& inputNames, Program& program, std::string& error) {
+    program = Program();
+    try {
+        std::vector<Token> tokens = tokenize(source);
+        Compiler compiler(tokens, inputNames, program);
+        compiler.compile();
+        return true;
+    }
+    catch (const std::exception& e) {
+        error = e.what();
+        program = Program();
+        return false;
+    }
+}
+
+} // namespace glsl
@@ -0,0 +1,120 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cmath>
+
+namespace glsl {
+
+// straight-line scalar code compiled from a fragment shader that sticks to a
+// small GLSL subset: float/vec2-4/bool math, the common builtins, user
+// functions and if/else, but no loops, arrays, textures or varyings. vectors
+// are split into components and functions are inlined at compile time, so
+// running it is a single pass over ops that can't branch, call or allocate
+struct Program {
+    enum Opcode {
+        OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_NEG,
+        OP_SIN, OP_COS, OP_TAN, OP_ASIN, OP_ACOS, OP_ATAN, OP_ATAN2,
+        OP_POW, OP_EXP, OP_LOG, OP_EXP2, OP_LOG2, OP_SQRT, OP_INVERSESQRT,
+        OP_ABS, OP_SIGN, OP_FLOOR, OP_CEIL, OP_FRACT, OP_MOD, OP_MIN, OP_MAX,
+        OP_CLAMP, OP_MIX, OP_STEP, OP_SMOOTHSTEP,
+        OP_LT, OP_LE, OP_GT, OP_GE, OP_EQ, OP_NE, OP_AND, OP_OR, OP_NOT, OP_SELECT,
+        OPCODES_LEN
+    };
+
+    // registers[dst] = apply(code, registers[a], registers[b], registers[c]).
+    // unused operands point at register 0
+    struct Op {
+        int code;
+        int dst;
+        int a;
+        int b;
+        int c;
+    };
+
+    bool isValid = false;
+    std::vector<Op> ops;
+    // constants, inputs and one register per op result
+    std::vector<float> registers;
+    // register of each input name passed to compileProgram(), -1 if the shader never reads it
+    std::vector<int> inputs;
+    int outputs[4] = {0, 0, 0, 0};
+
+    bool usesInput(int input) const {
+        return inputs[input] >= 0;
+    }
+
+    void setInput(int input, float value) {
+        if (inputs[input] >= 0) registers[inputs[input]] = value;
+    }
+
+    // gl_FragColor component i after the last run()
+    float getOutput(int i) const {
+        return registers[outputs[i]];
+    }
+
+    void run() {
+        float* r = registers.data();
+        for (const Op& op : ops) {
+            r[op.dst] = apply(op.code, r[op.a], r[op.b], r[op.c]);
+        }
+    }
+
+    static inline float apply(int code, float a, float b, float c) {
+        switch (code) {
+            case OP_ADD: return a + b;
+            case OP_SUB: return a - b;
+            case OP_MUL: return a * b;
+            case OP_DIV: return a / b;
+            case OP_NEG: return -a;
+            case OP_SIN: return std::sin(a);
+            case OP_COS: return std::cos(a);
+            case OP_TAN: return std::tan(a);
+            case OP_ASIN: return std::asin(a);
+            case OP_ACOS: return std::acos(a);
+            case OP_ATAN: return std::atan(a);
+            case OP_ATAN2: return std::atan2(a, b);
+            case OP_POW: return std::pow(a, b);
+            case OP_EXP: return std::exp(a);
+            case OP_LOG: return std::log(a);
+            case OP_EXP2: return std::exp2(a);
+            case OP_LOG2: return std::log2(a);
+            case OP_SQRT: return std::sqrt(a);
+            case OP_INVERSESQRT: return 1.f / std::sqrt(a);
+            case OP_ABS: return std::fabs(a);
+            case OP_SIGN: return (float)(a > 0.f) - (float)(a < 0.f);
+            case OP_FLOOR: return std::floor(a);
+            case OP_CEIL: return std::ceil(a);
+            case OP_FRACT: return a - std::floor(a);
+            case OP_MOD: return a - b * std::floor(a / b);
+            case OP_MIN: return b < a ? b : a;
+            case OP_MAX: return a < b ? b : a;
+            case OP_CLAMP: return std::fmin(std::fmax(a, b), c);
+            case OP_MIX: return a * (1.f - c) + b * c;
+            case OP_STEP: return b < a ? 0.f : 1.f;
+            case OP_SMOOTHSTEP: {
+                float t = std::fmin(std::fmax((c - a) / (b - a), 0.f), 1.f);
+                return t * t * (3.f - 2.f * t);
+            }
+            case OP_LT: return a < b ? 1.f : 0.f;
+            case OP_LE: return a <= b ? 1.f : 0.f;
+            case OP_GT: return a > b ? 1.f : 0.f;
+            case OP_GE: return a >= b ? 1.f : 0.f;
+            case OP_EQ: return a == b ? 1.f : 0.f;
+            case OP_NE: return a != b ? 1.f : 0.f;
+            case OP_AND: return (a != 0.f && b != 0.f) ? 1.f : 0.f;
+            case OP_OR: return (a != 0.f || b != 0.f) ? 1.f : 0.f;
+            case OP_NOT: return a == 0.f ? 1.f : 0.f;
+            case OP_SELECT: return a != 0.f ? b : c;
+            default: return 0.f;
+        }
+    }
+};
+
+// compiles main() of a fragment shader into program. inputNames lists the
+// float uniforms the caller will set with Program::setInput(), in that order;
+// "gl_FragCoord.x" and "gl_FragCoord.y" may be listed too. other uniforms read
+// 0 like unset uniforms on the GPU. returns false with the reason in error
+// when the shader leaves the subset, so callers can keep it on the GPU
+bool compileProgram(const std::string& source, const std::vector<std::string>& inputNames, Program& program, std::string& error);
+
+} // namespace glsl
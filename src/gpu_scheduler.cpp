@@ -0,0 +1,129 @@
+#include "gpu_scheduler.hpp"
+#include "compile_queue.hpp"
+#include <algorithm>
+#include <chrono>
+
+GpuScheduler::~GpuScheduler() {
+    if (running) stop();
+}
+
+void GpuScheduler::add(GpuJob* job) {
+    if (!job) return;
+    if (!running && !failed) {
+        start();
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.push_back(job);
+}
+
+void GpuScheduler::remove(GpuJob* job) {
+    if (!job) return;
+    bool empty;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto it = std::find(jobs.begin(), jobs.end(), job);
+        if (it != jobs.end()) jobs.erase(it);
+        if (running) {
+            removals.push_back(job);
+            wake.notify_all();
+            removed.wait(lock, [&]() {
+                return std::find(removals.begin(), removals.end(), job) == removals.end();
+            });
+        } else {
+            // never stepped, so it owns no GL objects
+            delete job;
+        }
+        empty = jobs.empty();
+    }
+    if (empty && running) {
+        stop();
+    }
+}
+
+bool GpuScheduler::start() {
+    GLFWwindow* share = APP->window ? APP->window->win : nullptr;
+    // headless Rack never initializes GLFW or GLEW
+    needsGlew = !share;
+    if (!share && glfwInit() != GLFW_TRUE) {
+        WARN("GpuScheduler: Could not initialize GLFW, GPU processing is disabled");
+        failed = true;
+        return false;
+    }
+
+    glfwDefaultWindowHints();
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    window = glfwCreateWindow(1, 1, "0x502 GPU", NULL, share);
+    if (!window) {
+        WARN("GpuScheduler: Could not create offscreen context, GPU processing is disabled");
+        failed = true;
+        return false;
+    }
+
+    running = true;
+    thread = std::thread(&GpuScheduler::run, this);
+    INFO("GpuScheduler: Started %s offscreen context", share ? "shared" : "standalone");
+    return true;
+}
+
+void GpuScheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    wake.notify_all();
+    if (thread.joinable()) thread.join();
+    if (window) {
+        glfwDestroyWindow(window);
+        window = nullptr;
+    }
+}
+
+void GpuScheduler::deleteRemovals() {
+    for (GpuJob* job : removals) {
+        delete job;
+    }
+    removals.clear();
+    removed.notify_all();
+}
+
+void GpuScheduler::run() {
+    system::setThreadName("0x502 GPU");
+    glfwMakeContextCurrent(window);
+
+    bool ok = true;
+    if (needsGlew) {
+        glewExperimental = GL_TRUE;
+        if (glewInit() != GLEW_OK) {
+            WARN("GpuScheduler: Could not initialize GLEW, GPU processing is disabled");
+            ok = false;
+        }
+    }
+    contextReady = ok;
+
+    std::vector<GpuJob*> stepping;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (running) {
+        deleteRemovals();
+        if (contextReady) {
+            // stepped without the lock, so add() and remove() on the main thread
+            // don't wait out a slow tick. a job removed meanwhile is only
+            // deleted at the top of the next pass, and remove() waits for that
+            stepping = jobs;
+            lock.unlock();
+            CompileQueue::getInstance().update();
+            for (GpuJob* job : stepping) {
+                job->gpuStep();
+            }
+            lock.lock();
+        }
+        float tick = TICK_SECONDS;
+        // a remove() that notified while the lock was released isn't missed
+        wake.wait_for(lock, std::chrono::duration<float>(tick), [&]() {
+            return !running || !removals.empty();
+        });
+    }
+    deleteRemovals();
+
+    contextReady = false;
+    glfwMakeContextCurrent(NULL);
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "plugin.hpp"
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// GPU work that belongs to a module rather than to its widget. gpuStep() is
+// called on the scheduler thread with the scheduler's offscreen context
+// current, whether or not the module is visible (or Rack has a window at all).
+// jobs are deleted on that thread too, so destructors may release GL objects
+struct GpuJob {
+    // bytes of textures and buffers the job holds, kept up to date by the job
+    // so the UI thread can show it
+    std::atomic<size_t> gpuMemory{0};
+
+    virtual ~GpuJob() {}
+    virtual void gpuStep() = 0;
+};
+
+// runs GpuJobs on a worker thread with a hidden GLFW window whose context is
+// shared with Rack's (or standalone when headless). add()/remove() must be
+// called from the main thread since GLFW windows can only be created and
+// destroyed there; modules do it in onAdd()/onRemove()
+class GpuScheduler {
+public:
+    static GpuScheduler& getInstance() {
+        static GpuScheduler instance;
+        return instance;
+    }
+
+    static constexpr float TICK_SECONDS = 0.005f;
+
+    void add(GpuJob* job);
+    // blocks until the job is no longer running, then deletes it
+    void remove(GpuJob* job);
+    // false when no offscreen context could be created; jobs never run then
+    bool hasContext() const { return contextReady; }
+
+private:
+    GpuScheduler() {}
+    ~GpuScheduler();
+    GpuScheduler(const GpuScheduler&) = delete;
+    GpuScheduler& operator=(const GpuScheduler&) = delete;
+
+    bool start();
+    void stop();
+    void run();
+    void deleteRemovals();
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable removed;
+    std::vector<GpuJob*> jobs;
+    std::vector<GpuJob*> removals;
+    std::thread thread;
+    bool running = false;
+    bool failed = false;
+    bool needsGlew = false;
+    GLFWwindow* window = nullptr;
+    std::atomic<bool> contextReady{false};
+};
@@ -0,0 +1,200 @@
+#include "program_binary_cache.hpp"
+#include "worker.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <sys/stat.h>
+#include <utime.h>
+
+namespace {
+
+const char MAGIC[8] = {'0', 'x', '5', '0', '2', 'P', 'B', '1'};
+
+struct Header {
+    char magic[8];
+    uint32_t format;
+    uint32_t keySize;
+    uint32_t binarySize;
+};
+
+// FNV-1a, since std::hash may change between builds and the names must not
+uint64_t hashKey(const std::string& key) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : key) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+int64_t getModifiedTime(const std::string& path) {
+    struct stat buffer;
+    if (stat(path.c_str(), &buffer) != 0) return -1;
+    return (int64_t)buffer.st_mtime;
+}
+
+bool writeBinary(const std::string& path, const std::string& key, GLenum format, const std::vector<uint8_t>& binary) {
+    // written next to the final name and renamed, so load() never sees half a file
+    std::string tempPath = path + ".tmp";
+    FILE* file = std::fopen(tempPath.c_str(), "wb");
+    if (!file) {
+        WARN("ProgramBinaryCache: Could not open %s", tempPath.c_str());
+        return false;
+    }
+    Header header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.format = format;
+    header.keySize = key.size();
+    header.binarySize = binary.size();
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1
+        && std::fwrite(key.data(), 1, key.size(), file) == key.size()
+        && std::fwrite(binary.data(), 1, binary.size(), file) == binary.size();
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok) {
+        WARN("ProgramBinaryCache: Could not write %s", tempPath.c_str());
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    // rename() doesn't replace existing files on Windows
+    std::remove(path.c_str());
+    if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+struct Entry {
+    std::string path;
+    int64_t mtime;
+    uint64_t size;
+};
+
+void evict(const std::string& directory) {
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    for (const std::string& path : system::getEntries(directory)) {
+        if (path.size() < 4 || path.compare(path.size() - 4, 4, ".bin") != 0) continue;
+        Entry entry;
+        entry.path = path;
+        entry.mtime = getModifiedTime(path);
+        entry.size = system::getFileSize(path);
+        total += entry.size;
+        entries.push_back(entry);
+    }
+    if (total <= ProgramBinaryCache::MAX_BYTES) return;
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.mtime < b.mtime;
+    });
+    for (const Entry& entry : entries) {
+        if (total <= ProgramBinaryCache::MAX_BYTES) break;
+        if (system::remove(entry.path)) total -= entry.size;
+    }
+}
+
+} // namespace
+
+bool ProgramBinaryCache::isSupported() {
+    if (!(GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)) return false;
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+std::string ProgramBinaryCache::getDriver() {
+    std::string driver;
+    const GLenum names[] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+    for (GLenum name : names) {
+        const GLubyte* value = glGetString(name);
+        if (value) driver += (const char*)value;
+        driver += '\n';
+    }
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+    std::vector<GLint> formats(count);
+    if (count > 0) glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data());
+    for (GLint format : formats) {
+        driver += std::to_string(format) + " ";
+    }
+    return driver;
+}
+
+std::string ProgramBinaryCache::getKey(const std::string& vertexSource, const std::string& fragmentSource) {
+    return getDriver() + '\0' + vertexSource + '\0' + fragmentSource;
+}
+
+std::string ProgramBinaryCache::getDirectory() {
+    return asset::user(pluginInstance->slug + "/programs");
+}
+
+std::string ProgramBinaryCache::getPath(const std::string& key) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)hashKey(key));
+    return system::join(getDirectory(), name);
+}
+
+bool ProgramBinaryCache::load(GLuint program, const std::string& vertexSource, const std::string& fragmentSource) {
+    if (!isSupported()) return false;
+    std::string key = getKey(vertexSource, fragmentSource);
+    std::string path = getPath(key);
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) return false;
+
+    Header header;
+    std::string storedKey;
+    std::vector<uint8_t> binary;
+    bool ok = std::fread(&header, sizeof(header), 1, file) == 1
+        && std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0
+        && header.keySize == key.size();
+    if (ok) {
+        storedKey.resize(header.keySize);
+        binary.resize(header.binarySize);
+        ok = std::fread(&storedKey[0], 1, storedKey.size(), file) == storedKey.size()
+            && std::fread(binary.data(), 1, binary.size(), file) == binary.size()
+            && storedKey == key;
+    }
+    std::fclose(file);
+    // another shader or another driver under the same name; the next store() replaces it
+    if (!ok || binary.empty()) return false;
+
+    glProgramBinary(program, header.format, binary.data(), binary.size());
+    GLint linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        INFO("ProgramBinaryCache: Driver rejected %s, compiling from source", path.c_str());
+        system::remove(path);
+        return false;
+    }
+    // the modification time doubles as the last use for eviction
+    utime(path.c_str(), NULL);
+    return true;
+}
+
+void ProgramBinaryCache::prepare(GLuint program) {
+    if (!isSupported()) return;
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void ProgramBinaryCache::store(GLuint program, const std::string& vertexSource, const std::string& fragmentSource) {
+    if (!isSupported()) return;
+    GLint size = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+    if (size <= 0) return;
+    std::vector<uint8_t> binary(size);
+    GLenum format = 0;
+    glGetProgramBinary(program, size, &size, &format, binary.data());
+    if (size <= 0) return;
+    binary.resize(size);
+
+    std::string key = getKey(vertexSource, fragmentSource);
+    std::string path = getPath(key);
+    std::string directory = getDirectory();
+    Worker::getInstance().push([directory, path, key, format, binary]() {
+        system::createDirectories(directory);
+        if (writeBinary(path, key, format, binary)) {
+            evict(directory);
+        }
+    });
+}
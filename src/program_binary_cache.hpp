@@ -0,0 +1,42 @@
+#pragma once
+#include "plugin.hpp"
+#include <cstdint>
+#include <string>
+
+// linked programs saved to the Rack user folder with glGetProgramBinary, so a
+// patch that was opened before links its shaders without running the compiler.
+// files are named by a hash of the sources and the driver (vendor, renderer,
+// version and binary formats), and hold the full key so a collision or a driver
+// update reads as a miss. a binary the driver rejects is deleted and compiled
+// from source again. the folder is kept under MAX_BYTES by evicting the files
+// used least recently. files are written on the Worker; load() reads on the
+// calling thread, with a GL context current
+class ProgramBinaryCache {
+public:
+    static const uint64_t MAX_BYTES = 64 * 1024 * 1024;
+
+    static ProgramBinaryCache& getInstance() {
+        static ProgramBinaryCache instance;
+        return instance;
+    }
+
+    // false without GL_ARB_get_program_binary, or when the driver offers no formats
+    bool isSupported();
+    // links `program` from a saved binary. false on a miss; the program is
+    // left unlinked and can still be built from source
+    bool load(GLuint program, const std::string& vertexSource, const std::string& fragmentSource);
+    // call before glLinkProgram, so the driver keeps the binary around
+    void prepare(GLuint program);
+    // saves a successfully linked program
+    void store(GLuint program, const std::string& vertexSource, const std::string& fragmentSource);
+
+private:
+    ProgramBinaryCache() {}
+    ProgramBinaryCache(const ProgramBinaryCache&) = delete;
+    ProgramBinaryCache& operator=(const ProgramBinaryCache&) = delete;
+
+    std::string getDriver();
+    std::string getKey(const std::string& vertexSource, const std::string& fragmentSource);
+    std::string getDirectory();
+    std::string getPath(const std::string& key);
+};
@@ -3,7 +3,10 @@
 #include <map>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include "plugin.hpp"
 #include "logger.hpp"
+#include "compile_queue.hpp"
 
 struct ShaderPair {
     std::string name;
@@ -31,6 +34,7 @@ public:
     }
     
     void registerGlib(int64_t glibId) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
         if (glibShaders.find(glibId) == glibShaders.end()) {
             glibShaders[glibId] = std::vector<ShaderPair>();
             //INFO("Registered new Glib %lld in shader library", glibId);
@@ -38,6 +42,7 @@ public:
     }
     
     void addShader(int64_t glibId, const ShaderPair& shader) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
         if (glibShaders.find(glibId) != glibShaders.end()) {
             glibShaders[glibId].push_back(shader);
             //INFO("Added shader '%s' to Glib %lld (total shaders: %d)", shader.name.c_str(), glibId, (int)glibShaders[glibId].size());
@@ -47,6 +52,7 @@ public:
     }
     
     void subscribeToShader(int64_t moduleId, int64_t glibId, int shaderIndex) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
         //INFO("SharedShaderLibrary: Attempting to subscribe module %lld to Glib %lld, shader %d", moduleId, glibId, shaderIndex);
         
         ShaderSubscription sub;
@@ -64,6 +70,7 @@ public:
     }
     
     const ShaderPair* getShaderForModule(int64_t moduleId) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
         auto subIt = moduleSubscriptions.find(moduleId);
         if (subIt == moduleSubscriptions.end()) {
             //INFO("SharedShaderLibrary: No subscription found for module %lld", moduleId);
@@ -90,6 +97,7 @@ public:
     }
     
     bool isValidSubscription(int64_t glibId, int shaderIndex) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
         auto glibIt = glibShaders.find(glibId);
         if (glibIt == glibShaders.end()) {
             //INFO("SharedShaderLibrary: Invalid subscription: Glib %lld not found", glibId);
@@ -103,6 +111,7 @@ public:
     }
 
     const ShaderSubscription* getSubscription(int64_t moduleId) const {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
         auto it = moduleSubscriptions.find(moduleId);
         /*
         if (it != moduleSubscriptions.end()) {
@@ -115,6 +124,7 @@ public:
     }
 
     std::vector<int64_t> getGlibIds() const {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
         std::vector<int64_t> ids;
         for (const auto& pair : glibShaders) {
             ids.push_back(pair.first);
@@ -124,6 +134,7 @@ public:
     }
 
     const std::vector<ShaderPair>* getShadersForGlib(int64_t glibId) const {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
         auto it = glibShaders.find(glibId);
         /*
         if (it != glibShaders.end()) {
@@ -133,7 +144,100 @@ public:
         return it != glibShaders.end() ? &it->second : nullptr;
     }
 
+    // the pointers above are only safe on the UI thread, where GLIB adds shaders.
+    // other threads (e.g. the GPU scheduler) take copies instead
+    bool copySubscription(int64_t moduleId, ShaderSubscription& subscription) const {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        const ShaderSubscription* sub = getSubscription(moduleId);
+        if (!sub) return false;
+        subscription = *sub;
+        return true;
+    }
+
+    bool copyShaderForModule(int64_t moduleId, ShaderPair& shader) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        const ShaderPair* pair = getShaderForModule(moduleId);
+        if (!pair) return false;
+        shader = *pair;
+        return true;
+    }
+
+    bool hasValidShaderForModule(int64_t moduleId) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        const ShaderPair* pair = getShaderForModule(moduleId);
+        return pair && pair->isValid;
+    }
+
+    enum ProgramStatus {
+        PROGRAM_PENDING,
+        PROGRAM_READY,
+        PROGRAM_FAILED
+    };
+
+    // linked programs are shared by every subscriber running the same sources, so
+    // ten modules on one GLIB shader compile it once. entries are per GL context:
+    // the UI thread and the GPU scheduler each get their own copy, since uniforms
+    // live in the program and the two threads set them concurrently. within one
+    // context every subscriber sets its uniforms before drawing. the context must
+    // be current. the program name comes back right away and is built through the
+    // CompileQueue; use it once getProgramStatus() says it is ready
+    GLuint acquireProgram(const std::string& vertexSource, const std::string& fragmentSource) {
+        ProgramKey key(glfwGetCurrentContext(), vertexSource + '\0' + fragmentSource);
+        std::lock_guard<std::mutex> lock(programMutex);
+        auto it = programs.find(key);
+        if (it == programs.end()) {
+            it = programs.insert(std::make_pair(key, CachedProgram())).first;
+            CachedProgram& cached = it->second;
+            cached.program = glCreateProgram();
+            cached.job = CompileQueue::getInstance().push(cached.program, vertexSource, fragmentSource);
+            programEntries[ProgramName(key.first, cached.program)] = it;
+        }
+        it->second.refs++;
+        return it->second.program;
+    }
+
+    ProgramStatus getProgramStatus(GLuint program) {
+        std::lock_guard<std::mutex> lock(programMutex);
+        auto entryIt = programEntries.find(ProgramName(glfwGetCurrentContext(), program));
+        if (entryIt == programEntries.end()) return PROGRAM_FAILED;
+        CachedProgram& cached = entryIt->second->second;
+        if (cached.job && cached.job->isFinished()) {
+            cached.failed = cached.job->state == CompileQueue::Job::FAILED;
+            cached.job = nullptr;
+        }
+        if (cached.job) return PROGRAM_PENDING;
+        return cached.failed ? PROGRAM_FAILED : PROGRAM_READY;
+    }
+
+    // deletes the program once its last subscriber lets go, even mid-compile.
+    // same context as acquireProgram()
+    void releaseProgram(GLuint program) {
+        if (!program) return;
+        {
+            std::lock_guard<std::mutex> lock(programMutex);
+            auto entryIt = programEntries.find(ProgramName(glfwGetCurrentContext(), program));
+            if (entryIt == programEntries.end()) return;
+            auto it = entryIt->second;
+            if (--it->second.refs > 0) return;
+            programs.erase(it);
+            programEntries.erase(entryIt);
+        }
+        glDeleteProgram(program);
+    }
+
 private:
+    // (context, vertex + '\0' + fragment)
+    typedef std::pair<GLFWwindow*, std::string> ProgramKey;
+    typedef std::pair<GLFWwindow*, GLuint> ProgramName;
+
+    struct CachedProgram {
+        GLuint program = 0;
+        int refs = 0;
+        // until the queue is done with it
+        CompileQueue::Handle job;
+        bool failed = false;
+    };
+
     SharedShaderLibrary() {
         INFO("SharedShaderLibrary initialized");
     }
@@ -142,4 +246,9 @@ private:
     
     std::map<int64_t, std::vector<ShaderPair>> glibShaders;
     std::map<int64_t, ShaderSubscription> moduleSubscriptions;
+    mutable std::recursive_mutex mutex;
+
+    std::map<ProgramKey, CachedProgram> programs;
+    std::map<ProgramName, std::map<ProgramKey, CachedProgram>::iterator> programEntries;
+    std::mutex programMutex;
 }; 
@@ -1,6 +1,4 @@
 #include "shader_menu.hpp"
-#include "glcv.hpp"
-#include "canvas.hpp"
 
 using namespace rack;
 
@@ -0,0 +1,115 @@
+#pragma once
+#include <string>
+#include <regex>
+#include <cstdlib>
+
+// source-level helpers for running a GLIB shader somewhere it wasn't written for
+// (another pipeline stage, a wrapper main(), per-texel uniforms, ...)
+namespace glsl {
+
+inline bool isIdentifierChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+inline size_t findIdentifier(const std::string& source, const std::string& name, size_t from = 0) {
+    size_t pos = source.find(name, from);
+    while (pos != std::string::npos) {
+        bool startOk = pos == 0 || !isIdentifierChar(source[pos - 1]);
+        size_t end = pos + name.length();
+        bool endOk = end >= source.length() || !isIdentifierChar(source[end]);
+        if (startOk && endOk) return pos;
+        pos = source.find(name, pos + 1);
+    }
+    return std::string::npos;
+}
+
+inline bool containsIdentifier(const std::string& source, const std::string& name) {
+    return findIdentifier(source, name) != std::string::npos;
+}
+
+inline std::string replaceIdentifier(const std::string& source, const std::string& from, const std::string& to) {
+    std::string result;
+    size_t last = 0;
+    size_t pos = findIdentifier(source, from);
+    while (pos != std::string::npos) {
+        result.append(source, last, pos - last);
+        result += to;
+        last = pos + from.length();
+        pos = findIdentifier(source, from, last);
+    }
+    result.append(source, last, std::string::npos);
+    return result;
+}
+
+// removes the `#version` line (if any) and returns it through `versionLine`
+inline std::string splitVersion(const std::string& source, std::string& versionLine) {
+    versionLine.clear();
+    size_t pos = source.find("#version");
+    if (pos == std::string::npos) return source;
+    size_t end = source.find('\n', pos);
+    if (end == std::string::npos) end = source.length();
+    versionLine = source.substr(pos, end - pos);
+    return source.substr(0, pos) + source.substr(end);
+}
+
+inline int versionNumber(const std::string& versionLine) {
+    size_t pos = versionLine.find_first_of("0123456789");
+    return pos == std::string::npos ? 110 : std::atoi(versionLine.c_str() + pos);
+}
+
+// `uniform float name;` -> `float name;` so a wrapper main() can assign it.
+// returns false when the uniform isn't declared on its own
+inline bool demoteUniform(std::string& source, const std::string& name) {
+    std::regex declaration("\\buniform\\s+((?:(?:lowp|mediump|highp)\\s+)?\\w+)\\s+" + name + "\\s*;");
+    if (!std::regex_search(source, declaration)) return false;
+    source = std::regex_replace(source, declaration, "$1 " + name + ";");
+    return true;
+}
+
+// removes `uniform float name[N];` and returns N, or 0 if there is no such declaration
+inline int removeUniformArray(std::string& source, const std::string& name) {
+    std::regex declaration("\\buniform\\s+(?:(?:lowp|mediump|highp)\\s+)?float\\s+" + name + "\\s*\\[\\s*(\\d+)\\s*\\]\\s*;");
+    std::smatch match;
+    if (!std::regex_search(source, match, declaration)) return 0;
+    int size = std::atoi(match[1].str().c_str());
+    source = std::regex_replace(source, declaration, "");
+    return size;
+}
+
+// `name[expr]` -> `function(float(expr))`. brackets are matched, so expr may
+// index other arrays (including name). returns false if nothing was replaced
+inline bool replaceIndexing(std::string& source, const std::string& name, const std::string& function) {
+    bool replaced = false;
+    size_t pos = findIdentifier(source, name);
+    while (pos != std::string::npos) {
+        size_t open = pos + name.length();
+        while (open < source.length() && (source[open] == ' ' || source[open] == '\t')) open++;
+        if (open >= source.length() || source[open] != '[') {
+            pos = findIdentifier(source, name, pos + name.length());
+            continue;
+        }
+        int depth = 0;
+        size_t close = open;
+        for (; close < source.length(); close++) {
+            if (source[close] == '[') depth++;
+            if (source[close] == ']' && --depth == 0) break;
+        }
+        if (close >= source.length()) break;
+
+        std::string index = source.substr(open + 1, close - open - 1);
+        replaceIndexing(index, name, function);
+        std::string call = function + "(float(" + index + "))";
+        source.replace(pos, close + 1 - pos, call);
+        replaced = true;
+        pos = findIdentifier(source, name, pos + call.length());
+    }
+    return replaced;
+}
+
+// drops a storage qualifier everywhere, e.g. `varying` when the source no longer
+// runs as a fragment shader
+inline std::string stripQualifier(const std::string& source, const std::string& qualifier) {
+    return std::regex_replace(source, std::regex("\\b" + qualifier + "\\s+"), "");
+}
+
+} // namespace glsl
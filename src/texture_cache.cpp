@@ -0,0 +1,119 @@
+#include "texture_cache.hpp"
+#include "gl_utils.hpp"
+#include "worker.hpp"
+#include <cstring>
+#include <sys/stat.h>
+
+// stb_image is compiled into Rack, which loads NanoVG images with it, so the
+// plugin links against that copy instead of bundling its own
+extern "C" {
+unsigned char* stbi_load(const char* filename, int* x, int* y, int* channels, int desiredChannels);
+void stbi_image_free(void* data);
+const char* stbi_failure_reason(void);
+}
+
+static int64_t getModifiedTime(const std::string& path) {
+    struct stat buffer;
+    if (stat(path.c_str(), &buffer) != 0) return -1;
+    return (int64_t)buffer.st_mtime;
+}
+
+static void decodeImage(std::shared_ptr<TextureCache::Image> image, std::string path) {
+    int width, height, channels;
+    unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, 4);
+    if (!data) {
+        WARN("TextureCache: Could not decode %s: %s", path.c_str(), stbi_failure_reason());
+        image->failed = true;
+        image->decoded = true;
+        return;
+    }
+    // stb_image starts at the top row, GL at the bottom
+    size_t stride = (size_t)width * 4;
+    image->pixels.resize(stride * height);
+    for (int y = 0; y < height; y++) {
+        std::memcpy(&image->pixels[(size_t)(height - 1 - y) * stride], data + (size_t)y * stride, stride);
+    }
+    stbi_image_free(data);
+    image->width = width;
+    image->height = height;
+    image->decoded = true;
+}
+
+TextureCache::Texture::~Texture() {
+    if (texture) glDeleteTextures(1, &texture);
+}
+
+TextureCache::Handle TextureCache::acquire(const std::string& path) {
+    int64_t mtime = getModifiedTime(path);
+    Handle texture = textures[path].lock();
+    if (texture && texture->mtime == mtime) return texture;
+
+    texture = std::make_shared<Texture>();
+    texture->path = path;
+    texture->mtime = mtime;
+    texture->image = std::make_shared<Image>();
+    textures[path] = texture;
+    if (mtime < 0) {
+        WARN("TextureCache: Could not find %s", path.c_str());
+        texture->image = nullptr;
+        return texture;
+    }
+    std::shared_ptr<Image> image = texture->image;
+    Worker::getInstance().push([image, path]() {
+        decodeImage(image, path);
+    });
+    return texture;
+}
+
+void TextureCache::update() {
+    for (auto it = textures.begin(); it != textures.end();) {
+        Handle texture = it->second.lock();
+        if (!texture) {
+            it = textures.erase(it);
+            continue;
+        }
+        ++it;
+        if (!texture->image || !texture->image->decoded) continue;
+        if (!texture->image->failed) {
+            upload(*texture);
+        }
+        texture->image = nullptr;
+        return;
+    }
+}
+
+// through a pixel buffer, so the driver copies the image to the GPU on its own
+// time instead of during glTexImage2D
+void TextureCache::upload(Texture& texture) {
+    const Image& image = *texture.image;
+    size_t size = image.pixels.size();
+    if (!uploadBuffer) glGenBuffers(1, &uploadBuffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadBuffer);
+    if (size > uploadCapacity) {
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+        uploadCapacity = size;
+    }
+    void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (!mapped) {
+        WARN("TextureCache: Could not map the upload buffer for %s", texture.path.c_str());
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return;
+    }
+    std::memcpy(mapped, image.pixels.data(), size);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    glGenTextures(1, &texture.texture);
+    glBindTexture(GL_TEXTURE_2D, texture.texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    texture.width = image.width;
+    texture.height = image.height;
+    gl::checkError("TextureCache::upload");
+}
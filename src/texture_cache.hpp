@@ -0,0 +1,62 @@
+#pragma once
+#include "plugin.hpp"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// images for shaders, shared by every module that samples them. entries are
+// keyed by path and modification time, so an edited file is loaded again while
+// modules still holding the old version keep it. acquire() never blocks: the
+// image is decoded on the Worker, and a later update() streams it up through a
+// pixel buffer and builds the mipmaps. until then the texture is 0. UI thread
+// only; the GL texture is deleted with the last Handle, so drop handles with
+// the context current
+class TextureCache {
+public:
+    // decoder output, shared with the Worker
+    struct Image {
+        std::atomic<bool> decoded{false};
+        bool failed = false;
+        int width = 0;
+        int height = 0;
+        // RGBA8, bottom row first like GL
+        std::vector<uint8_t> pixels;
+    };
+
+    struct Texture {
+        std::string path;
+        int64_t mtime = 0;
+        GLuint texture = 0;
+        int width = 0;
+        int height = 0;
+        // null once uploaded, or if it failed
+        std::shared_ptr<Image> image;
+
+        bool isPending() const { return image != nullptr; }
+        ~Texture();
+    };
+    typedef std::shared_ptr<Texture> Handle;
+
+    static TextureCache& getInstance() {
+        static TextureCache instance;
+        return instance;
+    }
+
+    Handle acquire(const std::string& path);
+    // uploads at most one decoded image per call, so a patch full of images
+    // spreads its uploads over several frames. the GL context must be current
+    void update();
+
+private:
+    TextureCache() {}
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    void upload(Texture& texture);
+
+    std::map<std::string, std::weak_ptr<Texture>> textures;
+    GLuint uploadBuffer = 0;
+    size_t uploadCapacity = 0;
+};
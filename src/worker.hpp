@@ -0,0 +1,97 @@
+#pragma once
+#include "plugin.hpp"
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// a single background thread for CPU work that is too heavy for the audio
+// thread and has no business on the GPU scheduler (FFTs, table building, ...).
+// tasks run one at a time in the order they were pushed. push() locks and
+// allocates, so call it from the GPU or UI thread, never from process()
+class Worker {
+public:
+    static Worker& getInstance() {
+        static Worker instance;
+        return instance;
+    }
+
+    void push(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+            if (!thread.joinable()) {
+                thread = std::thread(&Worker::run, this);
+            }
+        }
+        wake.notify_one();
+    }
+
+private:
+    Worker() {}
+    ~Worker() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        wake.notify_all();
+        if (thread.joinable()) thread.join();
+    }
+    Worker(const Worker&) = delete;
+    Worker& operator=(const Worker&) = delete;
+
+    void run() {
+        system::setThreadName("0x502 worker");
+        std::unique_lock<std::mutex> lock(mutex);
+        while (running) {
+            if (tasks.empty()) {
+                wake.wait(lock);
+                continue;
+            }
+            std::function<void()> task = std::move(tasks.front());
+            tasks.pop_front();
+            lock.unlock();
+            task();
+            lock.lock();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::function<void()>> tasks;
+    std::thread thread;
+    bool running = true;
+};
+
+// hands objects built on the Worker to the audio thread without locks. the
+// worker publish()es into next; the audio thread take()s it only once retired
+// is empty, parking the object it stops using there for the next publish() to
+// delete. hold it in a shared_ptr so a task still in flight can outlive its module
+template <typename T>
+struct Handoff {
+    std::atomic<T*> next{nullptr};
+    std::atomic<T*> retired{nullptr};
+
+    ~Handoff() {
+        delete next.load();
+        delete retired.load();
+    }
+
+    // worker side
+    void publish(T* object) {
+        delete retired.exchange(nullptr);
+        delete next.exchange(object);
+    }
+
+    // audio side: swaps current for the newest published object, if any
+    bool take(T*& current) {
+        if (retired.load()) return false;
+        T* object = next.exchange(nullptr);
+        if (!object) return false;
+        retired = current;
+        current = object;
+        return true;
+    }
+};